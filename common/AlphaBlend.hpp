@@ -0,0 +1,179 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ALPHA_BLEND_SSE2
+#endif
+
+/** @brief Fixed point alpha blending of 8 bit BGR images.
+ *  Alpha is in 1/256 units and colors are premultiplied once, so blending a byte is one multiply, one add and a
+ *  shift: dst = (color * alpha + 128 + dst * (256 - alpha)) >> 8. Within +-1 of cv::addWeighted.
+ *  Used by Visualizer for the equalizer bars and the logo.
+ */
+namespace blend
+{
+    /** @brief BlendRow blends n bytes of dst with premultiplied color: dst = (premul + dst * inv) >> 8
+     * @param premul -- color * alpha + 128 for each byte, alpha in 1/256 units
+     * @param inv    -- 256 - alpha for each byte
+     */
+    inline void blendRow(uchar *dst, const uint16_t *premul, const uint16_t *inv, const int n)
+    {
+        int k = 0;
+#ifdef ALPHA_BLEND_SSE2
+        const __m128i zero = _mm_setzero_si128();
+        for (; k + 16 <= n; k += 16)
+        {
+            const __m128i px = _mm_loadu_si128((const __m128i *)(dst + k));
+            __m128i lo = _mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), _mm_loadu_si128((const __m128i *)(inv + k)));
+            __m128i hi = _mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), _mm_loadu_si128((const __m128i *)(inv + k + 8)));
+            lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_loadu_si128((const __m128i *)(premul + k))), 8);
+            hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_loadu_si128((const __m128i *)(premul + k + 8))), 8);
+            _mm_storeu_si128((__m128i *)(dst + k), _mm_packus_epi16(lo, hi));
+        }
+        for (; k + 8 <= n; k += 8)
+        {
+            __m128i px = _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)(dst + k)), zero);
+            px = _mm_mullo_epi16(px, _mm_loadu_si128((const __m128i *)(inv + k)));
+            px = _mm_srli_epi16(_mm_add_epi16(px, _mm_loadu_si128((const __m128i *)(premul + k))), 8);
+            _mm_storel_epi64((__m128i *)(dst + k), _mm_packus_epi16(px, zero));
+        }
+#endif
+        for (; k < n; k++)
+        {
+            dst[k] = (uchar)((premul[k] + dst[k] * inv[k]) >> 8);
+        }
+    }
+
+    /** @brief BlendRect fills rect of a CV_8UC3 image with color at the given opacity, like
+     *  cv::addWeighted(cv::Mat(rect.size(), CV_8UC3, color), alpha / 256., roi, 1 - alpha / 256., 0, roi)
+     * @param rect  -- Must lie inside img
+     * @param alpha -- Opacity in 1/256 units, 0 to 256
+     */
+    inline void blendRect(cv::Mat &img, const cv::Rect &rect, const cv::Scalar &color, const int alpha)
+    {
+        // The color row is premultiplied once for 8 pixels and reused for every chunk of every line.
+        const int chunk_pixels = 8;
+        uint16_t premul[chunk_pixels * 3];
+        uint16_t inv[chunk_pixels * 3];
+        for (int k = 0; k < chunk_pixels * 3; k++)
+        {
+            premul[k] = (uint16_t)(cv::saturate_cast<uchar>(color[k % 3]) * alpha + 128);
+            inv[k] = (uint16_t)(256 - alpha);
+        }
+
+        for (int y = rect.y; y < rect.y + rect.height; y++)
+        {
+            uchar *row = img.ptr<uchar>(y);
+            for (int x = rect.x; x < rect.x + rect.width; x += chunk_pixels)
+            {
+                const int pixels = (std::min)(chunk_pixels, rect.x + rect.width - x);
+                blendRow(row + x * 3, premul, inv, pixels * 3);
+            }
+        }
+    }
+
+    /** @brief Draws one image with per pixel opacity over others, many times.
+     *  prepare() premultiplies the image once and splits its rows into transparent, translucent and opaque runs;
+     *  composite() then skips the transparent runs, copies the opaque ones and blends only the rest.
+     */
+    class PremultipliedOverlay
+    {
+    public:
+
+        PremultipliedOverlay() : mCols(0) {}
+
+        /** @brief Prepare premultiplies foreground, whose last channel is its opacity (0 transparent, 255 opaque)
+         */
+        void prepare(const cv::Mat &foreground)
+        {
+            const int cn = foreground.channels();
+            mCols = foreground.cols;
+            mBgr.assign(foreground.rows * foreground.cols * 3, 0);
+            mPremul.assign(foreground.rows * foreground.cols * 3, 0);
+            mInv.assign(foreground.rows * foreground.cols * 3, 0);
+            mSpans.clear();
+
+            for (int y = 0; y < foreground.rows; y++)
+            {
+                const uchar *src = foreground.ptr<uchar>(y);
+                Span span;
+                span.row = y;
+                span.x = 0;
+                span.width = 0;
+                span.opaque = false;
+                for (int x = 0; x <= foreground.cols; x++)
+                {
+                    // 0: transparent, 1: translucent, 2: opaque
+                    int kind = 0;
+                    if (x < foreground.cols)
+                    {
+                        const int alpha = cvRound(src[x * cn + cn - 1] / 255. * 256);
+                        kind = alpha == 0 ? 0 : alpha == 256 ? 2 : 1;
+                        for (int c = 0; c < 3; c++)
+                        {
+                            const size_t i = (y * foreground.cols + x) * 3 + c;
+                            mBgr[i] = src[x * cn + (std::min)(c, cn - 1)];
+                            mPremul[i] = (uint16_t)(mBgr[i] * alpha + 128);
+                            mInv[i] = (uint16_t)(256 - alpha);
+                        }
+                    }
+
+                    const int span_kind = span.width == 0 ? 0 : span.opaque ? 2 : 1;
+                    if (kind != span_kind)
+                    {
+                        if (span.width > 0) mSpans.push_back(span);
+                        span.x = x;
+                        span.width = kind == 0 ? 0 : 1;
+                        span.opaque = kind == 2;
+                    }
+                    else if (kind != 0)
+                    {
+                        span.width++;
+                    }
+                }
+            }
+        }
+
+        /** @brief Composite draws the prepared image over background, a CV_8UC3 image (or ROI) of the same size.
+         *  Same result as the per pixel floating point blend within +-1.
+         */
+        void composite(cv::Mat &background) const
+        {
+            for (const Span &span : mSpans)
+            {
+                uchar *dst = background.ptr<uchar>(span.row) + span.x * 3;
+                const size_t offset = (span.row * mCols + span.x) * 3;
+                if (span.opaque)
+                {
+                    memcpy(dst, &mBgr[offset], span.width * 3);
+                }
+                else
+                {
+                    blendRow(dst, &mPremul[offset], &mInv[offset], span.width * 3);
+                }
+            }
+        }
+
+    private:
+
+        struct Span
+        {
+            int row;
+            int x;
+            int width;
+            bool opaque;
+        };
+
+        int mCols;
+        std::vector<Span> mSpans;
+        std::vector<uchar> mBgr;
+        std::vector<uint16_t> mPremul;    // color * alpha + 128 per byte
+        std::vector<uint16_t> mInv;       // 256 - alpha per byte
+    };
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <ostream>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include "FaceRecord.hpp"
+#include "ResultEncoder.hpp"
+#include "LatencyHistogram.hpp"
+#include "FrameClock.hpp"
+#include "TraceRecorder.hpp"
+
+/** @brief Writes the metrics file on a dedicated thread.
+ *  The caller only appends FaceRecords to an in-memory queue. The writer thread encodes them into a large
+ *  buffer (CSV or columnar, see ResultEncoder) which is written out once it exceeds FLUSH_BYTES or
+ *  FLUSH_INTERVAL has passed, so a slow disk never stalls the thread producing the records.
+ */
+class AsyncResultWriter
+{
+public:
+
+    static const size_t FLUSH_BYTES = 1 << 20;
+
+    /** @param out        -- Destination stream, only written to from the writer thread once the header is out
+     * @param encoder    -- Output format
+     * @param write_time -- Receives the time spent encoding and writing each batch, or nullptr
+     */
+    AsyncResultWriter(std::ostream &out, std::unique_ptr<ResultEncoder> encoder, LatencyHistogram *write_time = nullptr)
+        : mOut(&out), mEncoder(std::move(encoder)), mWriteTime(write_time), mStop(false), mFlushRequested(false),
+        mNextOut(nullptr), mCompletedFlushes(0)
+    {
+        mEncoder->writeHeader(*mOut);
+        mThread = std::thread(&AsyncResultWriter::run, this);
+    }
+
+    AsyncResultWriter(const AsyncResultWriter&) = delete;
+    AsyncResultWriter& operator=(const AsyncResultWriter&) = delete;
+
+    ~AsyncResultWriter()
+    {
+        close();
+    }
+
+    /** @brief Append queues rows for writing, it never touches the output stream
+     */
+    void append(const std::vector<FaceRecord> &records)
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        mPending.insert(mPending.end(), records.begin(), records.end());
+    }
+
+    /** @brief PendingCount returns the rows appended but not yet picked up by the writer thread
+     */
+    size_t pendingCount()
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        return mPending.size();
+    }
+
+    /** @brief Flush blocks until everything appended so far has been written and flushed to the stream
+     */
+    void flush()
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        if (mStop) return;
+        const unsigned long long target = mCompletedFlushes + 1;
+        mFlushRequested = true;
+        mWakeUp.notify_one();
+        mFlushed.wait(lk, [this, target] { return mCompletedFlushes >= target || mStop; });
+    }
+
+    /** @brief Retarget flushes everything appended so far to the current stream, then continues on out, starting
+     *  with a fresh header. Blocks until the switch is done.
+     */
+    void retarget(std::ostream &out)
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        if (mStop) return;
+        const unsigned long long target = mCompletedFlushes + 1;
+        mNextOut = &out;
+        mFlushRequested = true;
+        mWakeUp.notify_one();
+        mFlushed.wait(lk, [this, target] { return mCompletedFlushes >= target || mStop; });
+    }
+
+    /** @brief Close drains the queue, performs the final flush and stops the writer thread
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mStop) return;
+            mStop = true;
+        }
+        mWakeUp.notify_one();
+        mThread.join();
+    }
+
+private:
+
+    void run()
+    {
+        TRACE_THREAD_NAME("writer");
+        const std::chrono::milliseconds FLUSH_INTERVAL(1000);
+        std::vector<FaceRecord> batch;
+        auto lastFlush = std::chrono::steady_clock::now();
+
+        for (;;)
+        {
+            bool stop, flushRequested;
+            std::ostream *nextOut;
+            {
+                std::unique_lock<std::mutex> lk(mMutex);
+                mWakeUp.wait_for(lk, FLUSH_INTERVAL, [this] { return mStop || mFlushRequested; });
+                batch.swap(mPending);
+                stop = mStop;
+                flushRequested = mFlushRequested;
+                mFlushRequested = false;
+                nextOut = mNextOut;
+                mNextOut = nullptr;
+            }
+
+            const int64_t start = steadyNanos();
+            const bool work = !batch.empty();
+            if (work)
+            {
+                TRACE_SCOPE("writer.encode");
+                for (const FaceRecord &record : batch) mEncoder->append(record);
+                batch.clear();
+            }
+
+            const auto now = std::chrono::steady_clock::now();
+            if (stop || flushRequested || mEncoder->bufferedBytes() >= FLUSH_BYTES || now - lastFlush >= FLUSH_INTERVAL)
+            {
+                writeBuffer();
+                lastFlush = now;
+            }
+            if (mWriteTime && work) mWriteTime->record(steadyNanos() - start);
+            if (nextOut)
+            {
+                mOut = nextOut;
+                mEncoder->writeHeader(*mOut);
+                mOut->flush();
+            }
+
+            if (flushRequested)
+            {
+                std::lock_guard<std::mutex> lg(mMutex);
+                mCompletedFlushes++;
+                mFlushed.notify_all();
+            }
+            if (stop) break;
+        }
+        mFlushed.notify_all();
+    }
+
+    void writeBuffer()
+    {
+        if (mEncoder->bufferedBytes() == 0) return;
+        TRACE_SCOPE("writer.write");
+        mEncoder->flush(*mOut);
+        mOut->flush();
+    }
+
+    std::ostream *mOut;                         // only touched by the writer thread after construction
+    std::unique_ptr<ResultEncoder> mEncoder;    // only touched by the writer thread
+    LatencyHistogram *mWriteTime;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::condition_variable mFlushed;
+    std::vector<FaceRecord> mPending;
+    bool mStop;
+    bool mFlushRequested;
+    std::ostream *mNextOut;                     // stream requested by retarget(), taken over on the next flush
+    unsigned long long mCompletedFlushes;
+
+    std::thread mThread;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "SpscRing.hpp"
+#include "TraceRecorder.hpp"
+
+/** @brief Encodes annotated frames into a video file on a dedicated thread.
+ *  push() copies the frame into a pooled slot of a bounded queue and returns immediately. When the encoder falls a
+ *  whole queue behind, the frame is dropped (and counted) instead of making the caller wait.
+ *  The cv::VideoWriter is opened on the first frame, since that is when the frame size becomes known.
+ */
+class AsyncVideoWriter
+{
+public:
+
+    /** @param path           -- Output video file
+     * @param fps            -- Frame rate stored in the file
+     * @param fourcc         -- Codec, MJPG in an .avi works with every OpenCV build
+     * @param queue_capacity -- Frames that can wait for the encoder
+     */
+    AsyncVideoWriter(const std::string &path, const double fps,
+                     const int fourcc = CV_FOURCC('M', 'J', 'P', 'G'), const size_t queue_capacity = 32)
+        : mPath(path), mFps(fps), mFourcc(fourcc), mFrames(queue_capacity),
+        mStop(false), mWritten(0), mDropped(0)
+    {
+        mThread = std::thread(&AsyncVideoWriter::run, this);
+    }
+
+    AsyncVideoWriter(const AsyncVideoWriter&) = delete;
+    AsyncVideoWriter& operator=(const AsyncVideoWriter&) = delete;
+
+    ~AsyncVideoWriter()
+    {
+        close();
+    }
+
+    /** @brief Push queues a copy of frame for encoding. Must always be called from the same thread.
+     * @return false if the queue was full and the frame was dropped
+     */
+    bool push(const cv::Mat &frame)
+    {
+        cv::Mat *slot = mFrames.writeSlot();
+        if (!slot)
+        {
+            mDropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        frame.copyTo(*slot);
+        mFrames.commitWrite();
+        mWakeUp.notify_one();
+        return true;
+    }
+
+    /** @brief Close encodes the queued frames, finalizes the file and stops the encoder thread
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mStop) return;
+            mStop = true;
+        }
+        mWakeUp.notify_one();
+        mThread.join();
+    }
+
+    unsigned long long getWrittenCount() const
+    {
+        return mWritten.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getDroppedCount() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    void run()
+    {
+        TRACE_THREAD_NAME("export");
+        cv::VideoWriter writer;
+        bool failed = false;
+        while (true)
+        {
+            cv::Mat *frame = mFrames.readSlot();
+            if (!frame)
+            {
+                std::unique_lock<std::mutex> lk(mMutex);
+                if (mStop && mFrames.empty()) break;
+                // push() notifies without the lock, the timeout covers a wake-up sent just before we started waiting
+                mWakeUp.wait_for(lk, std::chrono::milliseconds(10), [this] { return mStop || !mFrames.empty(); });
+                continue;
+            }
+
+            if (!writer.isOpened() && !failed)
+            {
+                failed = !writer.open(mPath, mFourcc, mFps, frame->size(), true);
+                if (failed) std::cerr << "Unable to open video output file " << mPath << std::endl;
+            }
+            if (!failed)
+            {
+                TRACE_SCOPE("export.write");
+                writer.write(*frame);
+                mWritten.fetch_add(1, std::memory_order_relaxed);
+            }
+            mFrames.commitRead();
+        }
+        writer.release();
+    }
+
+    const std::string mPath;
+    const double mFps;
+    const int mFourcc;
+    SpscRing<cv::Mat> mFrames;
+    bool mStop;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::thread mThread;
+    std::atomic<unsigned long long> mWritten;
+    std::atomic<unsigned long long> mDropped;
+};
@@ -0,0 +1,202 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "FrameClock.hpp"
+#include "TraceRecorder.hpp"
+
+/** @brief Reads a camera on a dedicated thread into a fixed ring of preallocated frame buffers.
+ *  The capture thread does not wait for the consumer: when every buffer is full it overwrites the oldest frame not yet
+ *  acquired (and counts it as dropped), so the capture cadence does not depend on how long processing and drawing take.
+ *  cv::VideoCapture::read() decodes straight into the slot's buffer, which keeps its allocation as long as the camera
+ *  resolution does not change. The consumer gets frames in capture order and hands each slot back with release().
+ */
+class CaptureRing
+{
+public:
+
+    /** @brief A captured frame and the steadyNanos() time its read completed
+     */
+    struct CapturedFrame
+    {
+        cv::Mat image;
+        int64_t captureNs;
+        unsigned long long sequence;
+    };
+
+    /** @param capture -- Opened camera, used by the capture thread only from now on
+     * @param slots   -- Frame buffers, at least 3 (one being written, one held by the consumer, one ready)
+     */
+    CaptureRing(cv::VideoCapture &capture, const size_t slots = 4)
+        : mCapture(capture), mSlots((std::max)(slots, size_t(3))), mState(mSlots.size(), FREE),
+        mNextSequence(0), mStop(false), mEnded(false), mDropped(0)
+    {
+        const int width = (int)capture.get(CV_CAP_PROP_FRAME_WIDTH);
+        const int height = (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT);
+        for (CapturedFrame &slot : mSlots)
+        {
+            slot.captureNs = -1;
+            slot.sequence = 0;
+            if (width > 0 && height > 0) slot.image.create(height, width, CV_8UC3);
+        }
+        mThread = std::thread(&CaptureRing::run, this);
+    }
+
+    CaptureRing(const CaptureRing&) = delete;
+    CaptureRing& operator=(const CaptureRing&) = delete;
+
+    ~CaptureRing()
+    {
+        stop();
+    }
+
+    /** @brief Acquire waits for the oldest captured frame not yet handed out. The frame is valid until release().
+     * @return nullptr once the capture ended (camera failure or stop()) and every captured frame was handed out
+     */
+    const CapturedFrame *acquire()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        size_t oldest;
+        mReady.wait(lock, [&]() { return findOldest(READY, oldest) || mEnded; });
+        if (!findOldest(READY, oldest)) return nullptr;
+        mState[oldest] = HELD;
+        return &mSlots[oldest];
+    }
+
+    /** @brief Release hands a frame returned by acquire() back to the capture thread
+     */
+    void release(const CapturedFrame *frame)
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        mState[frame - mSlots.data()] = FREE;
+        mFreed.notify_one();
+    }
+
+    /** @brief Stop ends the capture thread (after the read in progress), acquire() then drains the captured frames
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mStop) return;
+            mStop = true;
+        }
+        mFreed.notify_one();
+        mThread.join();
+    }
+
+    unsigned long long getCapturedCount() const
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        return mNextSequence;
+    }
+
+    /** @brief Number of captured frames waiting for acquire()
+     */
+    size_t getReadyCount() const
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        return (size_t)std::count(mState.begin(), mState.end(), READY);
+    }
+
+    unsigned long long getDroppedCount() const
+    {
+        return mDropped.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    enum SlotState { FREE, WRITING, READY, HELD };
+
+    void run()
+    {
+        TRACE_THREAD_NAME("capture");
+        for (;;)
+        {
+            size_t target;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                // Only when the consumer holds all but one slot is there nothing to write into
+                mFreed.wait(lock, [&]() { return mStop || findFree(target) || findOldest(READY, target); });
+                if (mStop) break;
+                if (mState[target] == READY)
+                {
+                    // The consumer is behind: the oldest ready frame is the least useful one
+                    mDropped.fetch_add(1, std::memory_order_relaxed);
+                }
+                mState[target] = WRITING;
+            }
+
+            CapturedFrame &frame = mSlots[target];
+            bool ok;
+            {
+                TRACE_SCOPE("capture.read");
+                ok = mCapture.read(frame.image);
+            }
+            frame.captureNs = steadyNanos();
+
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (!ok)
+            {
+                mState[target] = FREE;
+                break;
+            }
+            frame.sequence = mNextSequence++;
+            mState[target] = READY;
+            mReady.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lg(mMutex);
+        mEnded = true;
+        mReady.notify_one();
+    }
+
+    // Called with mMutex held
+    bool findFree(size_t &index) const
+    {
+        for (size_t i = 0; i < mSlots.size(); i++)
+        {
+            if (mState[i] == FREE)
+            {
+                index = i;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Called with mMutex held
+    bool findOldest(const SlotState state, size_t &index) const
+    {
+        bool found = false;
+        for (size_t i = 0; i < mSlots.size(); i++)
+        {
+            if (mState[i] == state && (!found || mSlots[i].sequence < mSlots[index].sequence))
+            {
+                index = i;
+                found = true;
+            }
+        }
+        return found;
+    }
+
+    cv::VideoCapture &mCapture;
+    std::vector<CapturedFrame> mSlots;
+    std::vector<SlotState> mState;
+    unsigned long long mNextSequence;
+
+    mutable std::mutex mMutex;
+    std::condition_variable mReady;
+    std::condition_variable mFreed;
+    bool mStop;
+    bool mEnded;
+    std::atomic<unsigned long long> mDropped;
+
+    std::thread mThread;
+};
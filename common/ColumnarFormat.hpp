@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+/** @brief On-disk layout of the binary columnar result files (.afxc).
+ *
+ *  Integers and IEEE 754 values are stored in the byte order of the host that wrote the file, which FileHeader::byteOrder
+ *  records; a reader on a host of the other byte order rejects the file rather than converting it, so columns can
+ *  always be used in place. Every block starts on an 8 byte boundary.
+ *
+ *    FileHeader
+ *    ColumnHeader + name bytes        (columnCount times, each padded to 8)
+ *    ChunkHeader + one block per column, in schema order, each padded to 8   (repeated until end of file)
+ *
+ *  A column block holds ChunkHeader::rowCount values of the column's type, so within a chunk every
+ *  column can be used in place as a contiguous array.
+ */
+namespace columnar
+{
+    const char FILE_MAGIC[8] = { 'A', 'F', 'X', 'C', 'O', 'L', 'S', '\0' };
+    const uint32_t FILE_VERSION = 2;            // 2: FileHeader::byteOrder
+    const uint32_t CHUNK_MAGIC = 0x4b4e4843;    // "CHNK"
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;    // reads back as 0x04030201 with the other byte order
+
+    static_assert(std::numeric_limits<float>::is_iec559 && std::numeric_limits<double>::is_iec559,
+                  "The columnar format stores IEEE 754 floating point values");
+
+    enum ColumnType : uint32_t
+    {
+        FLOAT32 = 0,
+        FLOAT64 = 1,
+        INT32 = 2
+    };
+
+    inline size_t typeSize(const uint32_t type)
+    {
+        return type == FLOAT64 ? 8 : 4;
+    }
+
+    /** @brief TypeOf<T>::value is the column type holding values of type T
+     */
+    template <typename T> struct TypeOf;
+    template <> struct TypeOf<float> { static const uint32_t value = FLOAT32; };
+    template <> struct TypeOf<double> { static const uint32_t value = FLOAT64; };
+    template <> struct TypeOf<int32_t> { static const uint32_t value = INT32; };
+
+    inline size_t align8(const size_t n)
+    {
+        return (n + 7) & ~size_t(7);
+    }
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t columnCount;
+        uint32_t byteOrder;     // BYTE_ORDER_MARK as written by the host
+        uint32_t reserved;      // 0, keeps the header a multiple of 8 bytes
+    };
+
+    struct ColumnHeader
+    {
+        uint32_t type;
+        uint32_t nameLength;    // followed by nameLength bytes, not null terminated
+    };
+
+    struct ChunkHeader
+    {
+        uint32_t magic;
+        uint32_t rowCount;
+    };
+}
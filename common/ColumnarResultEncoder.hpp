@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "MetricSchema.hpp"
+#include "FaceRecord.hpp"
+#include "ResultEncoder.hpp"
+#include "ColumnarFormat.hpp"
+
+/** @brief Encodes results in the binary columnar format described in ColumnarFormat.hpp.
+ *  Rows are staged column by column and every flush() emits one chunk. Frames without a face are
+ *  stored with faceId -1, category codes -1 and NaN metrics.
+ */
+class ColumnarResultEncoder : public ResultEncoder
+{
+public:
+
+    ColumnarResultEncoder() : mRows(0)
+    {
+        addColumn("TimeStamp", columnar::FLOAT64);
+        addColumn("faceId", columnar::INT32);
+        addColumn("interocularDistance", columnar::FLOAT32);
+        addColumn("glasses", columnar::INT32);
+        addColumn("age", columnar::INT32);
+        addColumn("ethnicity", columnar::INT32);
+        addColumn("gender", columnar::INT32);
+        addColumn("dominantEmoji", columnar::INT32);
+        for (const metrics::Metric &metric : metrics::ALL) addColumn(metric.name, columnar::FLOAT32);
+    }
+
+    void writeHeader(std::ostream &out) override
+    {
+        columnar::FileHeader header;
+        memcpy(header.magic, columnar::FILE_MAGIC, sizeof(header.magic));
+        header.version = columnar::FILE_VERSION;
+        header.columnCount = (uint32_t)mColumns.size();
+        header.byteOrder = columnar::BYTE_ORDER_MARK;
+        header.reserved = 0;
+        out.write((const char *)&header, sizeof(header));
+
+        for (const Column &column : mColumns)
+        {
+            columnar::ColumnHeader ch;
+            ch.type = column.type;
+            ch.nameLength = (uint32_t)column.name.size();
+            out.write((const char *)&ch, sizeof(ch));
+            out.write(column.name.data(), column.name.size());
+            pad(out, sizeof(ch) + column.name.size());
+        }
+    }
+
+    void append(const FaceRecord &r) override
+    {
+        const float nan = std::numeric_limits<float>::quiet_NaN();
+        size_t c = 0;
+        put(c++, r.timestamp);
+        if (!r.hasFace)
+        {
+            put(c++, int32_t(-1));
+            put(c++, nan);
+            for (int i = 0; i < 5; i++) put(c++, int32_t(-1));
+            for (size_t i = 0; i < metrics::METRIC_COUNT; i++) put(c++, nan);
+        }
+        else
+        {
+            put(c++, int32_t(r.id));
+            put(c++, r.measurements.interocularDistance);
+            put(c++, int32_t(r.appearance.glasses));
+            put(c++, int32_t(r.appearance.age));
+            put(c++, int32_t(r.appearance.ethnicity));
+            put(c++, int32_t(r.appearance.gender));
+            put(c++, int32_t(r.emojis.dominantEmoji));
+            putValues(c, &r.measurements.orientation, metrics::HEAD_ANGLES);
+            putValues(c, &r.emotions, metrics::EMOTIONS);
+            putValues(c, &r.expressions, metrics::EXPRESSIONS);
+            putValues(c, &r.emojis, metrics::EMOJIS);
+        }
+        mRows++;
+    }
+
+    size_t bufferedBytes() const override
+    {
+        size_t bytes = 0;
+        for (const Column &column : mColumns) bytes += column.data.size();
+        return bytes;
+    }
+
+    void flush(std::ostream &out) override
+    {
+        if (mRows == 0) return;
+
+        columnar::ChunkHeader chunk;
+        chunk.magic = columnar::CHUNK_MAGIC;
+        chunk.rowCount = (uint32_t)mRows;
+        out.write((const char *)&chunk, sizeof(chunk));
+
+        for (Column &column : mColumns)
+        {
+            out.write(column.data.data(), column.data.size());
+            pad(out, column.data.size());
+            column.data.clear();
+        }
+        mRows = 0;
+    }
+
+private:
+
+    struct Column
+    {
+        std::string name;
+        uint32_t type;
+        std::vector<char> data;
+    };
+
+    void addColumn(const std::string &name, const columnar::ColumnType type)
+    {
+        Column column;
+        column.name = name;
+        column.type = type;
+        mColumns.push_back(column);
+    }
+
+    template <typename T>
+    void put(const size_t column, const T value)
+    {
+        std::vector<char> &data = mColumns[column].data;
+        const size_t offset = data.size();
+        data.resize(offset + sizeof(T));
+        memcpy(&data[offset], &value, sizeof(T));
+    }
+
+    void putValues(size_t &column, const void *group, const metrics::MetricRange &range)
+    {
+        for (const metrics::Metric &metric : range) put(column++, metrics::value(group, metric));
+    }
+
+    static void pad(std::ostream &out, const size_t written)
+    {
+        static const char zeros[8] = { 0 };
+        out.write(zeros, columnar::align8(written) - written);
+    }
+
+    std::vector<Column> mColumns;
+    size_t mRows;
+};
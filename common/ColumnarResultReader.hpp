@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "ColumnarFormat.hpp"
+
+/** @brief Contiguous, read-only run of column values
+ */
+template <typename T>
+struct ColumnSpan
+{
+    const T *data;
+    size_t size;
+
+    const T *begin() const { return data; }
+    const T *end() const { return data + size; }
+    const T &operator[](const size_t i) const { return data[i]; }
+};
+
+/** @brief Memory-maps a binary columnar result file (see ColumnarFormat.hpp).
+ *  Opening only walks the chunk headers. Values are never copied, column(chunk, index) points straight into the mapping.
+ *  Throws std::runtime_error if the file is not a valid result file or was written with the other byte order, and
+ *  std::out_of_range for a chunk or column index past the end.
+ */
+class ColumnarResultReader
+{
+public:
+
+    struct ColumnInfo
+    {
+        std::string name;
+        uint32_t type;
+    };
+
+    explicit ColumnarResultReader(const std::string &path)
+        : mFile(path.c_str(), boost::interprocess::read_only),
+        mRegion(mFile, boost::interprocess::read_only),
+        mRows(0)
+    {
+        const char *base = (const char *)mRegion.get_address();
+        const size_t size = mRegion.get_size();
+        size_t pos = 0;
+
+        const columnar::FileHeader *header = (const columnar::FileHeader *)take(base, size, pos, sizeof(columnar::FileHeader));
+        if (memcmp(header->magic, columnar::FILE_MAGIC, sizeof(header->magic)) != 0 || header->version != columnar::FILE_VERSION)
+        {
+            throw std::runtime_error("Not a columnar result file: " + path);
+        }
+        if (header->byteOrder != columnar::BYTE_ORDER_MARK)
+        {
+            throw std::runtime_error("Columnar result file written with a different byte order: " + path);
+        }
+
+        for (uint32_t i = 0; i < header->columnCount; i++)
+        {
+            const size_t start = pos;
+            const columnar::ColumnHeader *ch = (const columnar::ColumnHeader *)take(base, size, pos, sizeof(columnar::ColumnHeader));
+            ColumnInfo info;
+            info.type = ch->type;
+            if (info.type > columnar::INT32) throw std::runtime_error("Unknown column type in " + path);
+            info.name.assign(take(base, size, pos, ch->nameLength), ch->nameLength);
+            mColumns.push_back(info);
+            pos = start + columnar::align8(pos - start);
+        }
+
+        while (pos < size)
+        {
+            const columnar::ChunkHeader *chunk = (const columnar::ChunkHeader *)take(base, size, pos, sizeof(columnar::ChunkHeader));
+            if (chunk->magic != columnar::CHUNK_MAGIC) throw std::runtime_error("Corrupt chunk in " + path);
+
+            Chunk c;
+            c.rowCount = chunk->rowCount;
+            for (const ColumnInfo &column : mColumns)
+            {
+                const size_t bytes = c.rowCount * columnar::typeSize(column.type);
+                c.columns.push_back(take(base, size, pos, bytes));
+                pos = pos - bytes + columnar::align8(bytes);
+            }
+            mChunks.push_back(c);
+            mRows += c.rowCount;
+        }
+    }
+
+    size_t rowCount() const { return mRows; }
+    size_t chunkCount() const { return mChunks.size(); }
+    size_t chunkRowCount(const size_t chunk) const { return mChunks.at(chunk).rowCount; }
+
+    size_t columnCount() const { return mColumns.size(); }
+    const ColumnInfo &columnInfo(const size_t index) const { return mColumns.at(index); }
+
+    /** @return The index of the named column, or -1
+     */
+    int findColumn(const std::string &name) const
+    {
+        for (size_t i = 0; i < mColumns.size(); i++)
+        {
+            if (mColumns[i].name == name) return (int)i;
+        }
+        return -1;
+    }
+
+    /** @brief Column returns one column of one chunk as a span over the mapped file.
+     *  T must match the column type (float for FLOAT32, double for FLOAT64, int32_t for INT32).
+     */
+    template <typename T>
+    ColumnSpan<T> column(const size_t chunk, const size_t index) const
+    {
+        const ColumnInfo &info = mColumns.at(index);
+        if (columnar::TypeOf<T>::value != info.type) throw std::runtime_error("Column type mismatch: " + info.name);
+        const Chunk &c = mChunks.at(chunk);
+        ColumnSpan<T> span;
+        span.data = (const T *)c.columns[index];
+        span.size = c.rowCount;
+        return span;
+    }
+
+    /** @brief Gather copies one column of every chunk into a single vector
+     */
+    template <typename T>
+    std::vector<T> gather(const size_t index) const
+    {
+        std::vector<T> values;
+        values.reserve(mRows);
+        for (size_t chunk = 0; chunk < mChunks.size(); chunk++)
+        {
+            const ColumnSpan<T> span = column<T>(chunk, index);
+            values.insert(values.end(), span.begin(), span.end());
+        }
+        return values;
+    }
+
+private:
+
+    struct Chunk
+    {
+        size_t rowCount;
+        std::vector<const char *> columns;
+    };
+
+    static const char *take(const char *base, const size_t size, size_t &pos, const size_t bytes)
+    {
+        if (bytes > size - pos) throw std::runtime_error("Truncated columnar result file");
+        const char *p = base + pos;
+        pos += bytes;
+        return p;
+    }
+
+    boost::interprocess::file_mapping mFile;
+    boost::interprocess::mapped_region mRegion;
+    std::vector<ColumnInfo> mColumns;
+    std::vector<Chunk> mChunks;
+    size_t mRows;
+};
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cmath>
+#include <cstdio>
+#include <string>
+
+#include "MetricSchema.hpp"
+#include "FaceRecord.hpp"
+#include "ResultEncoder.hpp"
+
+/** @brief Formats metrics rows straight into a reusable char buffer.
+ *  Produces exactly the bytes an std::ostream set to std::fixed and precision(4) would, without going
+ *  through the locale and the stream machinery for every value.
+ */
+class CsvRowFormatter : public ResultEncoder
+{
+public:
+
+    CsvRowFormatter()
+    {
+        mBuffer.reserve(1 << 16);
+    }
+
+    void writeHeader(std::ostream &out) override
+    {
+        out << "TimeStamp,faceId,interocularDistance,glasses,age,ethnicity,gender,dominantEmoji,";
+        for (const metrics::Metric &metric : metrics::ALL) out << metric.name << ",";
+        out << std::endl;
+    }
+
+    void append(const FaceRecord &record) override { appendRow(record); }
+
+    size_t bufferedBytes() const override { return mBuffer.size(); }
+
+    void flush(std::ostream &out) override
+    {
+        if (mBuffer.empty()) return;
+        out.write(mBuffer.data(), mBuffer.size());
+        mBuffer.clear();
+    }
+
+    const char *data() const { return mBuffer.data(); }
+    size_t size() const { return mBuffer.size(); }
+
+    /** @brief Clear empties the buffer but keeps its capacity
+     */
+    void clear() { mBuffer.clear(); }
+
+    /** @brief AppendRow formats one CSV line (including the trailing newline)
+     */
+    void appendRow(const FaceRecord &r)
+    {
+        if (!r.hasFace)
+        {
+            appendFixed(r.timestamp);
+            append(",nan,nan,no,unknown,unknown,unknown,unknown,");
+            for (size_t i = 0; i < metrics::METRIC_COUNT; i++) append("nan,");
+            append('\n');
+            return;
+        }
+
+        appendFixed(r.timestamp);
+        append(',');
+        appendInt(r.id);
+        append(',');
+        appendFixed(r.measurements.interocularDistance);
+        append(',');
+        append(metrics::name(metrics::GLASSES_NAMES, r.appearance.glasses));
+        append(',');
+        append(metrics::name(metrics::AGE_NAMES, r.appearance.age));
+        append(',');
+        append(metrics::name(metrics::ETHNICITY_NAMES, r.appearance.ethnicity));
+        append(',');
+        append(metrics::name(metrics::GENDER_NAMES, r.appearance.gender));
+        append(',');
+        append(affdex::EmojiToString(r.emojis.dominantEmoji));
+        append(',');
+
+        appendValues(&r.measurements.orientation, metrics::HEAD_ANGLES);
+        appendValues(&r.emotions, metrics::EMOTIONS);
+        appendValues(&r.expressions, metrics::EXPRESSIONS);
+        appendValues(&r.emojis, metrics::EMOJIS);
+        append('\n');
+    }
+
+    void append(const char c) { mBuffer.push_back(c); }
+    void append(const char *s) { mBuffer.append(s); }
+    void append(const std::string &s) { mBuffer.append(s); }
+
+    void appendInt(long long value)
+    {
+        char tmp[24];
+        char *end = tmp + sizeof(tmp);
+        char *p = end;
+        const bool negative = value < 0;
+        unsigned long long u = negative ? 0ULL - (unsigned long long)value : (unsigned long long)value;
+        do
+        {
+            *--p = char('0' + u % 10);
+            u /= 10;
+        } while (u);
+        if (negative) *--p = '-';
+        mBuffer.append(p, end);
+    }
+
+    /** @brief AppendFixed writes value with four decimals, like printf("%.4f")
+     */
+    void appendFixed(const float value)
+    {
+        // A float has a 24 bit mantissa, so value * 10^4 is exact in a double and rounding it with the
+        // current (round-half-even) mode gives the same digits as the correctly rounded printf conversion.
+        const double scaled = std::nearbyint((double)value * 10000.0);
+        if (!(std::fabs(scaled) < 9007199254740992.0))    // 2^53, beyond that a double no longer holds every integer
+        {
+            appendPrintf((double)value);    // nan, inf and very large magnitudes
+            return;
+        }
+
+        const unsigned long long q = (unsigned long long)std::fabs(scaled);
+        if (std::signbit(value)) append('-');
+        appendInt((long long)(q / SCALE_INT));
+        append('.');
+        const unsigned frac = (unsigned)(q % SCALE_INT);
+        char digits[4] = { char('0' + frac / 1000), char('0' + frac / 100 % 10), char('0' + frac / 10 % 10), char('0' + frac % 10) };
+        mBuffer.append(digits, 4);
+    }
+
+    void appendFixed(const double value)
+    {
+        // Timestamps are usually floats promoted to double, which take the exact fast path.
+        const float narrowed = (float)value;
+        if ((double)narrowed == value)
+        {
+            appendFixed(narrowed);
+            return;
+        }
+        appendPrintf(value);
+    }
+
+private:
+
+    static const unsigned long long SCALE_INT = 10000;
+
+    void appendPrintf(const double value)
+    {
+        char tmp[512];
+        const int n = snprintf(tmp, sizeof(tmp), "%.4f", value);
+        if (n > 0) mBuffer.append(tmp, (size_t)n < sizeof(tmp) ? (size_t)n : sizeof(tmp) - 1);
+    }
+
+    void appendValues(const void *group, const metrics::MetricRange &range)
+    {
+        for (const metrics::Metric &metric : range)
+        {
+            appendFixed(metrics::value(group, metric));
+            append(',');
+        }
+    }
+
+    std::string mBuffer;
+};
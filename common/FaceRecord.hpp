@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Face.h"
+
+using namespace affdex;
+
+/** @brief Flat copy of the per-face values written to the output files.
+ *  Unlike affdex::Face it owns no heap memory, so records can be queued and copied between threads cheaply.
+ */
+struct FaceRecord
+{
+    FaceRecord() : timestamp(0), hasFace(false), id(0) {}
+
+    /** @brief Record for a frame in which no face was found
+     */
+    explicit FaceRecord(const double timeStamp) : timestamp(timeStamp), hasFace(false), id(0) {}
+
+    FaceRecord(const double timeStamp, const Face &f)
+        : timestamp(timeStamp), hasFace(true), id(f.id), measurements(f.measurements),
+        emotions(f.emotions), expressions(f.expressions), emojis(f.emojis), appearance(f.appearance)
+    {
+    }
+
+    double timestamp;
+    bool hasFace;
+    FaceId id;
+    Measurements measurements;
+    Emotions emotions;
+    Expressions expressions;
+    Emojis emojis;
+    Appearance appearance;
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "FrameGrabber.hpp"
+
+/** @brief Decodes the frames of a video that are due at the processing frame rate once, into a raw BGR file that is
+ *  memory-mapped for replay. Replaying hands out cv::Mat headers pointing straight into the mapping, so repeated passes
+ *  over the video cost neither decoding nor copying. The cache file lives in the temp directory and is removed with
+ *  the cache. Raw frames are large (about 6 MB for 1080p), so the cache is given a byte budget: a video that does not
+ *  fit is refused with BudgetExceeded, and the caller decodes it on every pass instead.
+ *  Replays through the same acquire()/release() interface as FrameGrabber, from a single consumer thread.
+ */
+class FrameCache
+{
+public:
+
+    /** @brief Thrown by the constructor when the decoded frames would take more than the byte budget
+     */
+    class BudgetExceeded : public std::runtime_error
+    {
+    public:
+        explicit BudgetExceeded(const std::string &what) : std::runtime_error(what) {}
+    };
+
+    /** @param path        -- Video file
+     * @param process_fps -- Frames per second to keep, as for FrameGrabber
+     * @param max_bytes   -- Most bytes of decoded frames the cache may hold, 0 for no limit
+     * @throws BudgetExceeded once the frames decoded so far pass max_bytes, with the partial cache file removed
+     */
+    FrameCache(const std::string &path, const double process_fps, const uint64_t max_bytes = 0)
+        : mPath(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("%%%%-%%%%-%%%%.framecache")),
+        mRows(0), mCols(0), mNext(0), mRealtime(false)
+    {
+        try
+        {
+            fill(path, process_fps, max_bytes);
+        }
+        catch (...)
+        {
+            boost::system::error_code ec;
+            boost::filesystem::remove(mPath, ec);
+            throw;
+        }
+        mFile.reset(new boost::interprocess::file_mapping(mPath.string().c_str(), boost::interprocess::read_only));
+        mRegion.reset(new boost::interprocess::mapped_region(*mFile, boost::interprocess::read_only));
+    }
+
+    FrameCache(const FrameCache&) = delete;
+    FrameCache& operator=(const FrameCache&) = delete;
+
+    ~FrameCache()
+    {
+        mRegion.reset();
+        mFile.reset();
+        boost::system::error_code ec;
+        boost::filesystem::remove(mPath, ec);
+    }
+
+    /** @brief Rewind restarts the replay at the first frame
+     * @param realtime -- Hand out frames at their timestamps (the original pace) rather than as fast as acquired
+     */
+    void rewind(const bool realtime)
+    {
+        mNext = 0;
+        mRealtime = realtime;
+        mStart = std::chrono::steady_clock::now();
+    }
+
+    /** @brief Acquire returns the next frame of the replay, waiting for its time in realtime mode.
+     *  The image points into the mapping and is valid as long as the cache.
+     * @return nullptr at the end of the replay
+     */
+    const FrameGrabber::GrabbedFrame *acquire()
+    {
+        if (mNext >= mTimestamps.size()) return nullptr;
+        if (mRealtime)
+        {
+            std::this_thread::sleep_until(mStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(mTimestamps[mNext] - mTimestamps[0])));
+        }
+        char *base = (char *)mRegion->get_address() + mNext * frameBytes();
+        mCurrent.image = cv::Mat(mRows, mCols, CV_8UC3, base);
+        mCurrent.timestamp = mTimestamps[mNext];
+        return &mCurrent;
+    }
+
+    void release()
+    {
+        mNext++;
+    }
+
+    double getFps() const
+    {
+        return mFps;
+    }
+
+    size_t size() const
+    {
+        return mTimestamps.size();
+    }
+
+    size_t frameBytes() const
+    {
+        return (size_t)mRows * mCols * 3;
+    }
+
+private:
+
+    /** @brief Fill decodes the video into the cache file, giving up as soon as it outgrows max_bytes
+     */
+    void fill(const std::string &path, const double process_fps, const uint64_t max_bytes)
+    {
+        FrameGrabber grabber(path, process_fps);
+        mFps = grabber.getFps();
+        std::ofstream out(mPath.c_str(), std::ios::out | std::ios::binary);
+        if (!out.is_open()) throw std::runtime_error("Unable to create frame cache " + mPath.string());
+
+        while (const FrameGrabber::GrabbedFrame *grabbed = grabber.acquire())
+        {
+            const cv::Mat &img = grabbed->image;
+            if (mTimestamps.empty())
+            {
+                mRows = img.rows;
+                mCols = img.cols;
+            }
+            if (img.rows != mRows || img.cols != mCols || img.type() != CV_8UC3)
+            {
+                throw std::runtime_error("Frame size changes within " + path + ", it can't be cached");
+            }
+            if (max_bytes > 0 && (mTimestamps.size() + 1) * (uint64_t)frameBytes() > max_bytes)
+            {
+                throw BudgetExceeded("The frames of " + path + " need more than the " +
+                                     std::to_string(max_bytes / (1024 * 1024)) + " MB frame cache budget");
+            }
+            for (int r = 0; r < img.rows; r++) out.write((const char *)img.ptr(r), mCols * 3);
+            mTimestamps.push_back(grabbed->timestamp);
+            grabber.release();
+        }
+        if (!out) throw std::runtime_error("Unable to write frame cache " + mPath.string());
+        if (mTimestamps.empty()) throw std::runtime_error("No frame could be decoded from " + path);
+    }
+
+    boost::filesystem::path mPath;
+    std::vector<double> mTimestamps;
+    double mFps;
+    int mRows;
+    int mCols;
+
+    std::unique_ptr<boost::interprocess::file_mapping> mFile;
+    std::unique_ptr<boost::interprocess::mapped_region> mRegion;
+
+    FrameGrabber::GrabbedFrame mCurrent;
+    size_t mNext;
+    bool mRealtime;
+    std::chrono::steady_clock::time_point mStart;
+};
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <chrono>
+
+/** @brief SteadyNanos reads the monotonic clock, in nanoseconds. Unaffected by wall-clock adjustments.
+ */
+inline int64_t steadyNanos()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/** @brief Identity of a submitted frame: its sequence number, its capture time and the timestamp handed to the SDK
+ */
+struct FrameStamp
+{
+    FrameStamp() : sequence(0), captureNs(-1), timestamp(0.0f) {}
+
+    uint64_t sequence;
+    int64_t captureNs;      // steadyNanos() when the frame was captured
+    float timestamp;        // seconds since the first frame, as given to affdex::Frame
+};
+
+/** @brief Remembers the stamps of the most recently submitted frames so the SDK callbacks, which only see the
+ *  affdex::Frame float timestamp, can recover the frame's sequence number and exact capture time.
+ *  The float timestamps are derived from the nanosecond capture times and kept strictly increasing, so they stay
+ *  unique even once float precision drops below the frame interval (after many days of capture).
+ *  Stamps live in a table indexed by a hash of the timestamp, four times the capacity in size. stamp() moves a
+ *  timestamp up by a float step while its slot still holds one of the last capacity stamps, so a live stamp is never
+ *  displaced and find() is a single probe. Slots are published with a sequence lock: neither side ever blocks the other.
+ */
+class FrameTimeline
+{
+public:
+
+    /** @param capacity -- Stamps kept, must cover the frames buffered by the detector
+     */
+    explicit FrameTimeline(const size_t capacity = 1024)
+        : mCapacity(capacity), mShift(32 - tableBits(capacity)), mSlots(new Slot[(size_t)1 << tableBits(capacity)]),
+        mNextSequence(0), mOriginNs(0), mLastTimestamp(-1.0f)
+    {
+    }
+
+    FrameTimeline(const FrameTimeline&) = delete;
+    FrameTimeline& operator=(const FrameTimeline&) = delete;
+
+    /** @brief Stamp assigns the next sequence number and the SDK timestamp to a frame captured at capture_ns.
+     *  Call from one thread only; find() may run concurrently from another.
+     */
+    FrameStamp stamp(const int64_t capture_ns)
+    {
+        if (mNextSequence == 0) mOriginNs = capture_ns;
+
+        FrameStamp s;
+        s.sequence = mNextSequence++;
+        s.captureNs = capture_ns;
+        s.timestamp = (float)((capture_ns - mOriginNs) * 1e-9);
+        if (s.timestamp <= mLastTimestamp) s.timestamp = std::nextafter(mLastTimestamp, std::numeric_limits<float>::max());
+        while (isLive(slot(s.timestamp), s.sequence))
+        {
+            s.timestamp = std::nextafter(s.timestamp, std::numeric_limits<float>::max());
+        }
+        mLastTimestamp = s.timestamp;
+
+        Slot &target = slot(s.timestamp);
+        const uint32_t version = target.version.load(std::memory_order_relaxed);
+        target.version.store(version + 1, std::memory_order_relaxed);    // odd: being written
+        std::atomic_thread_fence(std::memory_order_release);
+        target.timestampBits.store(bits(s.timestamp), std::memory_order_relaxed);
+        target.sequence.store(s.sequence, std::memory_order_relaxed);
+        target.captureNs.store(s.captureNs, std::memory_order_relaxed);
+        target.version.store(version + 2, std::memory_order_release);
+        return s;
+    }
+
+    /** @brief Find looks up the stamp of the frame the SDK reports with timestamp
+     * @return false if the frame is unknown or too old
+     */
+    bool find(const float timestamp, FrameStamp &out) const
+    {
+        const Slot &s = slot(timestamp);
+        const uint32_t version = s.version.load(std::memory_order_acquire);
+        if (version == 0 || (version & 1)) return false;    // never written, or being rewritten for another frame
+        const uint32_t stamped = s.timestampBits.load(std::memory_order_relaxed);
+        const uint64_t sequence = s.sequence.load(std::memory_order_relaxed);
+        const int64_t capture_ns = s.captureNs.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s.version.load(std::memory_order_relaxed) != version || stamped != bits(timestamp)) return false;
+
+        out.sequence = sequence;
+        out.captureNs = capture_ns;
+        out.timestamp = timestamp;
+        return true;
+    }
+
+private:
+
+    struct Slot
+    {
+        Slot() : version(0), timestampBits(0), sequence(0), captureNs(-1) {}
+
+        std::atomic<uint32_t> version;        // odd while stamp() rewrites the slot, 0 until first written
+        std::atomic<uint32_t> timestampBits;
+        std::atomic<uint64_t> sequence;
+        std::atomic<int64_t> captureNs;
+    };
+
+    /** @brief TableBits: log2 of the table size, the smallest power of two at least four times the capacity
+     */
+    static int tableBits(const size_t capacity)
+    {
+        int n = 1;
+        while (((size_t)1 << n) < 4 * capacity && n < 31) n++;
+        return n;
+    }
+
+    static uint32_t bits(const float timestamp)
+    {
+        uint32_t b;
+        memcpy(&b, &timestamp, sizeof(b));
+        return b;
+    }
+
+    // Fibonacci hashing: the top bits of the product spread consecutive floats evenly over the table
+    Slot &slot(const float timestamp)
+    {
+        return mSlots[(uint32_t)(bits(timestamp) * 2654435769u) >> mShift];
+    }
+
+    const Slot &slot(const float timestamp) const
+    {
+        return mSlots[(uint32_t)(bits(timestamp) * 2654435769u) >> mShift];
+    }
+
+    /** @brief IsLive tells whether s holds one of the capacity stamps before sequence. Only called by stamp(), the
+     *  slot's sole writer, so the plain loads see its own latest stores.
+     */
+    bool isLive(const Slot &s, const uint64_t sequence) const
+    {
+        return s.version.load(std::memory_order_relaxed) != 0
+            && s.sequence.load(std::memory_order_relaxed) + mCapacity >= sequence + 1;
+    }
+
+    const size_t mCapacity;
+    const int mShift;
+    std::unique_ptr<Slot[]> mSlots;
+
+    // Only touched by stamp()
+    uint64_t mNextSequence;
+    int64_t mOriginNs;
+    float mLastTimestamp;
+};
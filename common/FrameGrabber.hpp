@@ -0,0 +1,160 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <climits>
+#include <stdexcept>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "SpscRing.hpp"
+#include "TraceRecorder.hpp"
+
+/** @brief Decodes a video file on a dedicated thread, keeping only the frames due at the processing frame rate.
+ *  Every frame is grab()bed, which demuxes and decodes it, but only the kept ones are retrieve()d, which is where
+ *  the frame is converted to BGR and copied out. Kept frames wait in a bounded queue of reused buffers: when the
+ *  consumer falls behind, decoding pauses instead of dropping frames.
+ */
+class FrameGrabber
+{
+public:
+
+    /** @brief A decoded frame and its timestamp in the video (frame index / frame rate, in seconds)
+     */
+    struct GrabbedFrame
+    {
+        cv::Mat image;
+        double timestamp;
+    };
+
+    /** @param path           -- Video file
+     * @param process_fps    -- Frames per second to keep, frames closer than 1/process_fps to the last kept one are skipped
+     * @param first_frame    -- Index of the first frame to decode
+     * @param end_frame      -- Index of the frame to stop at (excluded)
+     * @param queue_capacity -- Kept frames that can wait for the consumer
+     */
+    FrameGrabber(const std::string &path, const double process_fps, const int first_frame = 0,
+                 const int end_frame = INT_MAX, const size_t queue_capacity = 8)
+        : mVideo(path), mFrames(queue_capacity), mProcessFps(process_fps), mFirstFrame(first_frame), mEndFrame(end_frame),
+        mStop(false), mDone(false), mGrabbed(0), mRetrieved(0)
+    {
+        if (!mVideo.isOpened()) throw std::runtime_error("Unable to open video " + path);
+        mFps = mVideo.get(CV_CAP_PROP_FPS);
+        if (mFps <= 0) throw std::runtime_error("Unable to read the frame rate of " + path);
+        if (first_frame > 0) mVideo.set(CV_CAP_PROP_POS_FRAMES, first_frame);
+        mThread = std::thread(&FrameGrabber::run, this);
+    }
+
+    FrameGrabber(const FrameGrabber&) = delete;
+    FrameGrabber& operator=(const FrameGrabber&) = delete;
+
+    ~FrameGrabber()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            mStop = true;
+        }
+        mSpaceFree.notify_one();
+        mThread.join();
+    }
+
+    /** @brief Acquire waits for the next kept frame. The frame stays valid until release().
+     * @return nullptr once the video (or the frame range) is over
+     */
+    const GrabbedFrame *acquire()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mFrameReady.wait(lock, [this]() { return !mFrames.empty() || mDone; });
+        return mFrames.readSlot();
+    }
+
+    /** @brief Release hands the frame returned by acquire() back to the decode thread
+     */
+    void release()
+    {
+        mFrames.commitRead();
+        std::lock_guard<std::mutex> lg(mMutex);
+        mSpaceFree.notify_one();
+    }
+
+    double getFps() const
+    {
+        return mFps;
+    }
+
+    unsigned long long getGrabbedCount() const
+    {
+        return mGrabbed.load(std::memory_order_relaxed);
+    }
+
+    unsigned long long getRetrievedCount() const
+    {
+        return mRetrieved.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    void run()
+    {
+        TRACE_THREAD_NAME("decode");
+        double next_ts = -1.0;
+        for (int i = mFirstFrame; i < mEndFrame; i++)
+        {
+            bool grabbed;
+            {
+                TRACE_SCOPE("video.grab");
+                grabbed = mVideo.grab();
+            }
+            if (!grabbed) break;
+            mGrabbed.fetch_add(1, std::memory_order_relaxed);
+
+            const double ts = i / mFps;
+            if (ts < next_ts) continue;
+            next_ts = ts + 1.0 / mProcessFps;
+
+            GrabbedFrame *slot;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mSpaceFree.wait(lock, [this]() { return mStop || mFrames.writeSlot() != nullptr; });
+                if (mStop) break;
+                slot = mFrames.writeSlot();
+            }
+            bool retrieved;
+            {
+                TRACE_SCOPE("video.retrieve");
+                retrieved = mVideo.retrieve(slot->image);
+            }
+            if (!retrieved) break;
+            slot->timestamp = ts;
+            mRetrieved.fetch_add(1, std::memory_order_relaxed);
+
+            mFrames.commitWrite();
+            std::lock_guard<std::mutex> lg(mMutex);
+            mFrameReady.notify_one();
+        }
+
+        std::lock_guard<std::mutex> lg(mMutex);
+        mDone = true;
+        mFrameReady.notify_one();
+    }
+
+    cv::VideoCapture mVideo;
+    SpscRing<GrabbedFrame> mFrames;
+    double mFps;
+    const double mProcessFps;
+    const int mFirstFrame;
+    const int mEndFrame;
+
+    std::mutex mMutex;
+    std::condition_variable mFrameReady;
+    std::condition_variable mSpaceFree;
+    bool mStop;
+    bool mDone;
+
+    std::atomic<unsigned long long> mGrabbed;
+    std::atomic<unsigned long long> mRetrieved;
+
+    std::thread mThread;
+};
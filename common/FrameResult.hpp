@@ -0,0 +1,101 @@
+#pragma once
+
+#include <map>
+#include <vector>
+
+#include "Frame.h"
+#include "Face.h"
+#include "FrameClock.hpp"
+
+using namespace affdex;
+
+/** @brief Read-only view over a contiguous run of faces
+ */
+class FaceRange
+{
+public:
+    FaceRange() : mBegin(nullptr), mEnd(nullptr) {}
+    FaceRange(const Face *first, const Face *last) : mBegin(first), mEnd(last) {}
+
+    const Face *begin() const { return mBegin; }
+    const Face *end() const { return mEnd; }
+    size_t size() const { return mEnd - mBegin; }
+    bool empty() const { return mBegin == mEnd; }
+
+private:
+    const Face *mBegin;
+    const Face *mEnd;
+};
+
+/** @brief Pooled storage for one processed frame.
+ *  Instances live in the listener's result ring and are refilled in place, so the Face objects are
+ *  recycled from frame to frame instead of being allocated for every result.
+ */
+struct FrameResult
+{
+    FrameResult() : numFaces(0), resultNs(-1) {}
+
+    /** @brief Assign copies the SDK's results into this slot, ordered by face id. Faces are copy-assigned into the
+     *  pool so each pooled Face keeps the storage of its feature points from frame to frame.
+     * @param faces   -- The faces reported by ImageListener::onImageResults
+     * @param image   -- The frame they were detected in
+     * @return true if the copy allocated: the face pool or a pooled face's feature points had to grow
+     */
+    bool assign(const std::map<FaceId, Face> &faces, Frame &image)
+    {
+        bool grew = reserve(faces.size());
+        numFaces = 0;
+        for (const auto &face_id_pair : faces)
+        {
+            grew |= reuse(face_id_pair.second);
+        }
+        frame = std::move(image);
+        return grew;
+    }
+
+    /** @brief CopyFrom copies another result into this slot, reusing the pooled faces
+     * @return true if the copy allocated, see assign()
+     */
+    bool copyFrom(const FaceRange &faces, const Frame &image)
+    {
+        bool grew = reserve(faces.size());
+        numFaces = 0;
+        for (const Face &face : faces)
+        {
+            grew |= reuse(face);
+        }
+        frame = image;
+        return grew;
+    }
+
+    FaceRange faces() const
+    {
+        return FaceRange(facePool.data(), facePool.data() + numFaces);
+    }
+
+    Frame frame;
+    std::vector<Face> facePool;    // only the first numFaces entries belong to this frame
+    size_t numFaces;
+    FrameStamp stamp;              // from the listener's FrameTimeline, captureNs is -1 if the frame was not stamped
+    int64_t resultNs;              // steadyNanos() when the SDK delivered the result
+
+private:
+
+    bool reserve(const size_t count)
+    {
+        const bool grew = facePool.capacity() < count;
+        if (facePool.size() < count) facePool.resize(count);
+        return grew;
+    }
+
+    /** @brief Reuse copies face into the next pooled face; vector copy-assignment keeps the existing capacity
+     * @return true if the feature points did not fit in it
+     */
+    bool reuse(const Face &face)
+    {
+        Face &pooled = facePool[numFaces++];
+        const bool grew = pooled.featurePoints.capacity() < face.featurePoints.size();
+        pooled = face;
+        return grew;
+    }
+};
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/** @brief Log-linear (HDR style) histogram of durations in nanoseconds.
+ *  Every power of two is split into 16 linear sub-buckets, so any recorded value is known within 1/16 (6.25%),
+ *  from 1ns to hours, in a fixed 960 counters. record() is a single relaxed atomic increment (plus a compare-exchange
+ *  when it sets a new maximum, and an add to the running sum), safe from any number of threads. The counters only
+ *  grow: drain() summarizes what was recorded since the previous drain, so each report covers its own interval,
+ *  while cumulative() reads the totals since construction, as a Prometheus scrape expects.
+ */
+class LatencyHistogram
+{
+public:
+
+    struct Summary
+    {
+        uint64_t count;
+        int64_t p50;
+        int64_t p90;
+        int64_t p99;
+        int64_t max;
+    };
+
+    LatencyHistogram() : mSum(0), mMax(0)
+    {
+        for (std::atomic<uint64_t> &count : mCounts) count.store(0, std::memory_order_relaxed);
+        for (uint64_t &count : mDrained) count = 0;
+    }
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /** @brief Record adds one duration, negative ones (unknown) are ignored
+     */
+    void record(const int64_t ns)
+    {
+        if (ns < 0) return;
+        mCounts[bucketOf((uint64_t)ns)].fetch_add(1, std::memory_order_relaxed);
+        mSum.fetch_add((uint64_t)ns, std::memory_order_relaxed);
+
+        int64_t max = mMax.load(std::memory_order_relaxed);
+        while (ns > max && !mMax.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {}
+    }
+
+    /** @brief Drain returns the percentiles recorded since the last drain and starts a new interval.
+     *  Percentiles are bucket midpoints, capped at the exact maximum. Call it from one thread at a time.
+     */
+    Summary drain()
+    {
+        uint64_t counts[BUCKETS];
+        Summary summary = { 0, 0, 0, 0, 0 };
+        for (size_t b = 0; b < BUCKETS; b++)
+        {
+            const uint64_t total = mCounts[b].load(std::memory_order_relaxed);
+            counts[b] = total - mDrained[b];
+            mDrained[b] = total;
+            summary.count += counts[b];
+        }
+        summary.max = mMax.exchange(0, std::memory_order_relaxed);
+        if (summary.count == 0) return summary;
+
+        summary.p50 = percentile(counts, summary.count, 0.50, summary.max);
+        summary.p90 = percentile(counts, summary.count, 0.90, summary.max);
+        summary.p99 = percentile(counts, summary.count, 0.99, summary.max);
+        return summary;
+    }
+
+    /** @brief Cumulative counts every value recorded so far at or below each bound, unaffected by drain().
+     *  Values are placed by their bucket midpoint, so a value within 1/32 of a bound may land on either side of it.
+     * @param bounds -- Upper bounds in nanoseconds, ascending
+     * @param counts -- Receives one cumulative count per bound
+     * @param sum    -- Receives the sum of every value, in nanoseconds
+     * @return the number of values recorded
+     */
+    uint64_t cumulative(const std::vector<int64_t> &bounds, std::vector<uint64_t> &counts, uint64_t &sum) const
+    {
+        counts.assign(bounds.size(), 0);
+        sum = mSum.load(std::memory_order_relaxed);
+        uint64_t total = 0;
+        size_t bound = 0;
+        for (size_t b = 0; b < BUCKETS; b++)
+        {
+            const uint64_t count = mCounts[b].load(std::memory_order_relaxed);
+            if (count == 0) continue;
+            const int64_t mid = bucketMidpoint(b);
+            while (bound < bounds.size() && bounds[bound] < mid) counts[bound++] = total;
+            total += count;
+        }
+        while (bound < bounds.size()) counts[bound++] = total;
+        return total;
+    }
+
+    /** @brief Format renders a summary as one report line, durations in milliseconds
+     */
+    static std::string format(const char *name, const Summary &s)
+    {
+        char line[160];
+        snprintf(line, sizeof(line), "%-16s n=%-8llu p50=%9.3fms p90=%9.3fms p99=%9.3fms max=%9.3fms", name,
+                 (unsigned long long)s.count, s.p50 / 1e6, s.p90 / 1e6, s.p99 / 1e6, s.max / 1e6);
+        return line;
+    }
+
+private:
+
+    static const int SUB_BITS = 4;
+    static const uint64_t SUB_BUCKETS = 1 << SUB_BITS;
+    static const size_t BUCKETS = (64 - SUB_BITS) << SUB_BITS;
+
+    static int highestBit(const uint64_t v)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanReverse64(&index, v);
+        return (int)index;
+#else
+        return 63 - __builtin_clzll(v);
+#endif
+    }
+
+    /** @brief BucketOf: values below 16 get a bucket each, larger ones share a bucket with the values that agree on
+     *  their top 5 bits
+     */
+    static size_t bucketOf(const uint64_t v)
+    {
+        if (v < SUB_BUCKETS) return (size_t)v;
+        const int shift = highestBit(v) - SUB_BITS;
+        return ((size_t)(shift + 1) << SUB_BITS) + (size_t)((v >> shift) & (SUB_BUCKETS - 1));
+    }
+
+    static int64_t bucketMidpoint(const size_t b)
+    {
+        if (b < SUB_BUCKETS) return (int64_t)b;
+        const int shift = (int)(b >> SUB_BITS) - 1;
+        const uint64_t lower = (SUB_BUCKETS + (b & (SUB_BUCKETS - 1))) << shift;
+        return (int64_t)(lower + ((uint64_t(1) << shift) >> 1));
+    }
+
+    static int64_t percentile(const uint64_t *counts, const uint64_t total, const double q, const int64_t max)
+    {
+        const uint64_t rank = (uint64_t)(q * total + 0.999999);    // ceil, at least 1
+        uint64_t seen = 0;
+        for (size_t b = 0; b < BUCKETS; b++)
+        {
+            seen += counts[b];
+            if (seen >= rank)
+            {
+                const int64_t mid = bucketMidpoint(b);
+                return mid < max ? mid : max;
+            }
+        }
+        return max;
+    }
+
+    std::atomic<uint64_t> mCounts[BUCKETS];     // since construction
+    std::atomic<uint64_t> mSum;
+    std::atomic<int64_t> mMax;                  // since the last drain
+    uint64_t mDrained[BUCKETS];                 // mCounts as of the last drain, only touched by drain()
+};
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include "FrameResult.hpp"
+#include "TraceRecorder.hpp"
+
+/** @brief Runs drawing on a dedicated thread, always drawing the newest submitted result.
+ *  Three FrameResult buffers rotate between the submitting thread (back), the hand-off (middle) and the render
+ *  thread (front). submit() copies into the back buffer and swaps it with the middle one, so the submitting thread
+ *  never waits for rendering. A result that is replaced before the render thread picks it up is skipped.
+ */
+class LatestFrameRenderer
+{
+public:
+
+    typedef std::function<void(const FaceRange &, Frame &)> RenderFunction;
+
+    explicit LatestFrameRenderer(RenderFunction render)
+        : mRender(render), mBack(&mBuffers[0]), mMiddle(&mBuffers[1]), mFront(&mBuffers[2]),
+        mFresh(false), mBusy(false), mStop(false), mRendered(0), mSkipped(0)
+    {
+        mThread = std::thread(&LatestFrameRenderer::run, this);
+    }
+
+    LatestFrameRenderer(const LatestFrameRenderer&) = delete;
+    LatestFrameRenderer& operator=(const LatestFrameRenderer&) = delete;
+
+    ~LatestFrameRenderer()
+    {
+        stop();
+    }
+
+    /** @brief Submit hands a copy of the result to the render thread, replacing any result it has not started on.
+     *  Must always be called from the same thread.
+     */
+    void submit(const FaceRange &faces, const Frame &frame)
+    {
+        mBack->copyFrom(faces, frame);
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mFresh) mSkipped.fetch_add(1, std::memory_order_relaxed);
+            std::swap(mBack, mMiddle);
+            mFresh = true;
+        }
+        mWakeUp.notify_one();
+    }
+
+    /** @brief WaitIdle blocks until the render thread has finished with every submitted result (drawn or skipped)
+     */
+    void waitIdle()
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        mIdle.wait(lk, [this] { return (!mFresh && !mBusy) || mStop; });
+    }
+
+    /** @brief Stop renders nothing more and joins the render thread
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mStop) return;
+            mStop = true;
+        }
+        mWakeUp.notify_one();
+        mIdle.notify_all();
+        mThread.join();
+    }
+
+    /** @brief Number of results drawn
+     */
+    unsigned long long getRenderedCount() const
+    {
+        return mRendered.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Number of results replaced by a newer one before they could be drawn
+     */
+    unsigned long long getSkippedCount() const
+    {
+        return mSkipped.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    void run()
+    {
+        TRACE_THREAD_NAME("render");
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> lk(mMutex);
+                mWakeUp.wait(lk, [this] { return mFresh || mStop; });
+                if (mStop) return;
+                std::swap(mFront, mMiddle);
+                mFresh = false;
+                mBusy = true;
+            }
+            mRender(mFront->faces(), mFront->frame);
+            mRendered.fetch_add(1, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lg(mMutex);
+                mBusy = false;
+            }
+            mIdle.notify_all();
+        }
+    }
+
+    RenderFunction mRender;
+    FrameResult mBuffers[3];
+    FrameResult *mBack;        // only touched by the submitting thread
+    FrameResult *mMiddle;      // guarded by mMutex
+    FrameResult *mFront;       // only touched by the render thread
+    bool mFresh;               // mMiddle holds a result not yet rendered
+    bool mBusy;                // the render thread is drawing mFront
+    bool mStop;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::condition_variable mIdle;
+    std::thread mThread;
+    std::atomic<unsigned long long> mRendered;
+    std::atomic<unsigned long long> mSkipped;
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+
+#include "Face.h"
+
+/** @brief Compile-time description of every per-face metric the samples write or draw.
+ *  Each metric knows its name, its byte offset inside its SDK struct (affdex::Orientation, affdex::Emotions,
+ *  affdex::Expressions or affdex::Emojis) and how it is displayed. The static_asserts below fail the build
+ *  if the SDK structs stop matching the tables.
+ */
+namespace metrics
+{
+    enum class Category { HEAD_ANGLE, EMOTION, EXPRESSION, EMOJI };
+
+    /** @brief Color of the equalizer bar drawn for the metric
+     */
+    enum class Tint { WHITE, RED, GREEN, VALENCE };
+
+    struct Metric
+    {
+        const char *name;
+        size_t offset;
+        Category category;
+        Tint tint;
+    };
+
+    /** @brief Contiguous slice of METRICS, usable in range-for
+     */
+    struct MetricRange
+    {
+        const Metric *first;
+        const Metric *last;
+
+        constexpr const Metric *begin() const { return first; }
+        constexpr const Metric *end() const { return last; }
+        constexpr size_t size() const { return last - first; }
+    };
+
+#define AFFDEX_METRIC(group, field, category, tint) { #field, offsetof(affdex::group, field), Category::category, Tint::tint }
+
+    /** @brief All metrics, in output column order
+     */
+    constexpr Metric METRICS[] = {
+        AFFDEX_METRIC(Orientation, pitch, HEAD_ANGLE, WHITE),
+        AFFDEX_METRIC(Orientation, yaw, HEAD_ANGLE, WHITE),
+        AFFDEX_METRIC(Orientation, roll, HEAD_ANGLE, WHITE),
+
+        AFFDEX_METRIC(Emotions, joy, EMOTION, GREEN),
+        AFFDEX_METRIC(Emotions, fear, EMOTION, RED),
+        AFFDEX_METRIC(Emotions, disgust, EMOTION, RED),
+        AFFDEX_METRIC(Emotions, sadness, EMOTION, RED),
+        AFFDEX_METRIC(Emotions, anger, EMOTION, RED),
+        AFFDEX_METRIC(Emotions, surprise, EMOTION, WHITE),
+        AFFDEX_METRIC(Emotions, contempt, EMOTION, RED),
+        AFFDEX_METRIC(Emotions, valence, EMOTION, VALENCE),
+        AFFDEX_METRIC(Emotions, engagement, EMOTION, WHITE),
+
+        AFFDEX_METRIC(Expressions, smile, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, innerBrowRaise, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, browRaise, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, browFurrow, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, noseWrinkle, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, upperLipRaise, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lipCornerDepressor, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, chinRaise, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lipPucker, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lipPress, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lipSuck, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, mouthOpen, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, smirk, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, eyeClosure, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, attention, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, eyeWiden, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, cheekRaise, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lidTighten, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, dimpler, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, lipStretch, EXPRESSION, WHITE),
+        AFFDEX_METRIC(Expressions, jawDrop, EXPRESSION, WHITE),
+
+        AFFDEX_METRIC(Emojis, relaxed, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, smiley, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, laughing, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, kissing, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, disappointed, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, rage, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, smirk, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, wink, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, stuckOutTongueWinkingEye, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, stuckOutTongue, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, flushed, EMOJI, WHITE),
+        AFFDEX_METRIC(Emojis, scream, EMOJI, WHITE)
+    };
+
+#undef AFFDEX_METRIC
+
+    constexpr size_t METRIC_COUNT = sizeof(METRICS) / sizeof(METRICS[0]);
+
+    constexpr MetricRange ALL = { METRICS, METRICS + METRIC_COUNT };
+    constexpr MetricRange HEAD_ANGLES = { METRICS, METRICS + 3 };
+    constexpr MetricRange EMOTIONS = { METRICS + 3, METRICS + 12 };
+    constexpr MetricRange EXPRESSIONS = { METRICS + 12, METRICS + 33 };
+    constexpr MetricRange EMOJIS = { METRICS + 33, METRICS + METRIC_COUNT };
+
+    // Every group must cover its SDK struct exactly (Emojis additionally ends with dominantEmoji).
+    static_assert(sizeof(affdex::Orientation) == HEAD_ANGLES.size() * sizeof(float), "affdex::Orientation layout changed");
+    static_assert(sizeof(affdex::Emotions) == EMOTIONS.size() * sizeof(float), "affdex::Emotions layout changed");
+    static_assert(sizeof(affdex::Expressions) == EXPRESSIONS.size() * sizeof(float), "affdex::Expressions layout changed");
+    static_assert(offsetof(affdex::Emojis, dominantEmoji) == EMOJIS.size() * sizeof(float), "affdex::Emojis layout changed");
+    static_assert(HEAD_ANGLES.first[0].category == Category::HEAD_ANGLE && HEAD_ANGLES.last[-1].category == Category::HEAD_ANGLE, "HEAD_ANGLES range");
+    static_assert(EMOTIONS.first[0].category == Category::EMOTION && EMOTIONS.last[-1].category == Category::EMOTION, "EMOTIONS range");
+    static_assert(EXPRESSIONS.first[0].category == Category::EXPRESSION && EXPRESSIONS.last[-1].category == Category::EXPRESSION, "EXPRESSIONS range");
+    static_assert(EMOJIS.first[0].category == Category::EMOJI && EMOJIS.last[-1].category == Category::EMOJI, "EMOJIS range");
+
+    /** @brief Value reads a metric out of its group struct, e.g. value(&face.emotions, m) for an EMOTION metric
+     */
+    inline float value(const void *group, const Metric &m)
+    {
+        return *reinterpret_cast<const float *>(reinterpret_cast<const char *>(group) + m.offset);
+    }
+
+    /** @brief Label lookup for the SDK's appearance enums: the array index is the enum value
+     */
+    template <typename E>
+    struct EnumName
+    {
+        E value;
+        const char *name;
+    };
+
+    template <typename E, size_t N>
+    inline const char *name(const EnumName<E> (&table)[N], const E value)
+    {
+        const size_t index = static_cast<size_t>(value);
+        return index < N ? table[index].name : "";
+    }
+
+    constexpr EnumName<affdex::Gender> GENDER_NAMES[] = {
+        { affdex::Gender::Unknown, "unknown" },
+        { affdex::Gender::Male, "male" },
+        { affdex::Gender::Female, "female" }
+    };
+
+    constexpr EnumName<affdex::Glasses> GLASSES_NAMES[] = {
+        { affdex::Glasses::No, "no" },
+        { affdex::Glasses::Yes, "yes" }
+    };
+
+    constexpr EnumName<affdex::Age> AGE_NAMES[] = {
+        { affdex::Age::AGE_UNKNOWN, "unknown" },
+        { affdex::Age::AGE_UNDER_18, "under 18" },
+        { affdex::Age::AGE_18_24, "18-24" },
+        { affdex::Age::AGE_25_34, "25-34" },
+        { affdex::Age::AGE_35_44, "35-44" },
+        { affdex::Age::AGE_45_54, "45-54" },
+        { affdex::Age::AGE_55_64, "55-64" },
+        { affdex::Age::AGE_65_PLUS, "65 plus" }
+    };
+
+    constexpr EnumName<affdex::Ethnicity> ETHNICITY_NAMES[] = {
+        { affdex::Ethnicity::UNKNOWN, "unknown" },
+        { affdex::Ethnicity::CAUCASIAN, "caucasian" },
+        { affdex::Ethnicity::BLACK_AFRICAN, "black african" },
+        { affdex::Ethnicity::SOUTH_ASIAN, "south asian" },
+        { affdex::Ethnicity::EAST_ASIAN, "east asian" },
+        { affdex::Ethnicity::HISPANIC, "hispanic" }
+    };
+
+    // The name tables are indexed by enum value, so entry i has to describe value i.
+    static_assert(static_cast<int>(affdex::Gender::Unknown) == 0 && static_cast<int>(affdex::Gender::Male) == 1
+                  && static_cast<int>(affdex::Gender::Female) == 2, "GENDER_NAMES must follow affdex::Gender values");
+    static_assert(static_cast<int>(affdex::Glasses::No) == 0 && static_cast<int>(affdex::Glasses::Yes) == 1,
+                  "GLASSES_NAMES must follow affdex::Glasses values");
+    static_assert(static_cast<int>(affdex::Age::AGE_UNKNOWN) == 0 && static_cast<int>(affdex::Age::AGE_65_PLUS) == 7,
+                  "AGE_NAMES must follow affdex::Age values");
+    static_assert(static_cast<int>(affdex::Ethnicity::UNKNOWN) == 0 && static_cast<int>(affdex::Ethnicity::HISPANIC) == 5,
+                  "ETHNICITY_NAMES must follow affdex::Ethnicity values");
+}
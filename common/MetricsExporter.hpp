@@ -0,0 +1,216 @@
+#pragma once
+
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <boost/asio.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/version.hpp>
+
+#include "PrometheusText.hpp"
+
+/** @brief Publishes metrics in the Prometheus text format, over HTTP and/or as a file.
+ *  The HTTP endpoint listens on 127.0.0.1 only and answers GET /metrics (try `curl localhost:<port>/metrics`) from
+ *  its own thread. The file is rewritten every interval through a rename, so readers such as the node_exporter
+ *  textfile collector never see half a page. Every request or dump runs the collectors, which read counters and
+ *  gauges and must therefore be safe to call from the exporter's threads.
+ */
+class MetricsExporter
+{
+public:
+
+    typedef std::function<void(PrometheusText &)> Collector;
+
+#if BOOST_VERSION >= 106600
+    typedef boost::asio::io_context IoContext;
+#else
+    typedef boost::asio::io_service IoContext;
+#endif
+
+    MetricsExporter() : mStop(false) {}
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    ~MetricsExporter()
+    {
+        stop();
+    }
+
+    /** @brief AddCollector registers a source of metric families. Call before start().
+     */
+    void addCollector(const Collector &collector)
+    {
+        mCollectors.push_back(collector);
+    }
+
+    /** @brief Render runs every collector into one page
+     */
+    std::string render() const
+    {
+        PrometheusText page;
+        for (const Collector &collector : mCollectors) collector(page);
+        return page.str();
+    }
+
+    /** @brief Start publishes on whichever outputs are requested. When the port cannot be bound the file is used
+     *  alone, so a deployment that is not allowed a port still gets its metrics.
+     * @param port     -- Local TCP port for the HTTP endpoint, 0 for none
+     * @param file     -- File rewritten every interval, empty for none
+     * @param interval -- Seconds between file dumps
+     * @throws boost::system::system_error if the port cannot be bound and there is no file to fall back on
+     */
+    void start(const unsigned short port, const std::string &file, const double interval)
+    {
+        if (port > 0)
+        {
+            try
+            {
+                serve(port);
+            }
+            catch (boost::system::system_error &ex)
+            {
+                if (file.empty()) throw;
+                std::cerr << "Cannot serve metrics on port " << port << " (" << ex.what() << "), writing them to "
+                    << file << " only" << std::endl;
+            }
+        }
+        if (!file.empty()) dumpTo(file, interval);
+    }
+
+    /** @brief Stop closes the endpoint and writes the file one last time
+     */
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mStop) return;
+            mStop = true;
+        }
+        mStopped.notify_one();
+        mIo.stop();
+        if (mServer.joinable()) mServer.join();
+        if (mDumper.joinable()) mDumper.join();
+        mAcceptor.reset();
+    }
+
+private:
+
+    /** @brief A request being answered, kept alive by the pending asio handlers
+     */
+    struct Connection
+    {
+        explicit Connection(IoContext &io) : socket(io), request(8192) {}
+
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::streambuf request;
+        std::string response;
+    };
+
+    void serve(const unsigned short port)
+    {
+        const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address_v4::loopback(), port);
+        mAcceptor.reset(new boost::asio::ip::tcp::acceptor(mIo, endpoint));
+        accept();
+        mServer = std::thread([this]() { mIo.run(); });
+    }
+
+    void accept()
+    {
+        std::shared_ptr<Connection> connection = std::make_shared<Connection>(mIo);
+        mAcceptor->async_accept(connection->socket, [this, connection](const boost::system::error_code &ec)
+        {
+            if (ec == boost::asio::error::operation_aborted) return;
+            if (!ec) read(connection);
+            accept();
+        });
+    }
+
+    void read(const std::shared_ptr<Connection> &connection)
+    {
+        boost::asio::async_read_until(connection->socket, connection->request, "\r\n\r\n",
+            [this, connection](const boost::system::error_code &ec, size_t)
+        {
+            if (ec) return;    // closed, or a request too large for the buffer
+            std::istream request(&connection->request);
+            std::string method, target;
+            request >> method >> target;
+            connection->response = respond(method, target);
+            boost::asio::async_write(connection->socket, boost::asio::buffer(connection->response),
+                [connection](const boost::system::error_code &, size_t)
+            {
+                boost::system::error_code ignored;
+                connection->socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+            });
+        });
+    }
+
+    std::string respond(const std::string &method, const std::string &target) const
+    {
+        std::string status = "200 OK";
+        std::string body;
+        if (method != "GET")
+        {
+            status = "405 Method Not Allowed";
+        }
+        else if (target != "/metrics" && target.compare(0, 9, "/metrics?") != 0)
+        {
+            status = "404 Not Found";
+            body = "Metrics are served at /metrics\n";
+        }
+        else
+        {
+            body = render();
+        }
+        return "HTTP/1.1 " + status + "\r\n"
+            "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+            "Content-Length: " + std::to_string(body.size()) + "\r\n"
+            "Connection: close\r\n\r\n" + body;
+    }
+
+    void dumpTo(const std::string &file, const double interval)
+    {
+        const std::chrono::milliseconds period((long long)((interval > 0 ? interval : 1.0) * 1000));
+        mDumper = std::thread([this, file, period]()
+        {
+            std::unique_lock<std::mutex> lk(mMutex);
+            for (bool last = false; !last;)
+            {
+                last = mStopped.wait_for(lk, period, [this] { return mStop; });
+                lk.unlock();
+                dump(file);
+                lk.lock();
+            }
+        });
+    }
+
+    void dump(const std::string &file) const
+    {
+        const std::string temp = file + ".tmp";
+        {
+            std::ofstream out(temp.c_str(), std::ios::binary | std::ios::trunc);
+            out << render();
+            if (!out) return;
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(temp, file, ec);
+        if (ec) std::cerr << "Cannot write metrics to " << file << ": " << ec.message() << std::endl;
+    }
+
+    std::vector<Collector> mCollectors;
+    IoContext mIo;
+    std::unique_ptr<boost::asio::ip::tcp::acceptor> mAcceptor;
+    std::thread mServer;
+    std::thread mDumper;
+    std::mutex mMutex;
+    std::condition_variable mStopped;
+    bool mStop;
+};
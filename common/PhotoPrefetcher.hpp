@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <boost/filesystem.hpp>
+
+#include "PhotoResultCache.hpp"
+#include "TraceRecorder.hpp"
+
+// cv::IMREAD_REDUCED_* (decoding JPEGs at 1/2, 1/4 or 1/8 size) appeared in OpenCV 3.2
+#if !defined(CV_VERSION_EPOCH) && (CV_VERSION_MAJOR > 3 || (CV_VERSION_MAJOR == 3 && CV_VERSION_MINOR >= 2))
+#define PHOTO_PREFETCHER_REDUCED_DECODE
+#endif
+
+/** @brief Decodes a list of photos on a pool of threads, ahead of the consumer.
+ *  At most `depth` decoded photos are held at any time. next() hands them out in list order.
+ *  Photos whose longer side is at least twice max_size are shrunk by a power of two while decoding (JPEG on
+ *  OpenCV 3.2+) or right after it, since the face detector gains nothing from the extra pixels.
+ *  With a result cache, photos whose results are cached are not decoded at all.
+ */
+class PhotoPrefetcher
+{
+public:
+
+    struct Photo
+    {
+        Photo() : key(0), cached(false) {}
+        cv::Mat image;                      // BGR image, empty if the file could not be read or the results are cached
+        uint64_t key;                       // result cache key, when there is a cache
+        bool cached;                        // records holds the cached results
+        std::vector<FaceRecord> records;
+    };
+
+    /** @param photos   -- Files to decode
+     * @param threads  -- Decode threads
+     * @param depth    -- Decoded photos allowed to wait for the consumer
+     * @param max_size -- Target size of the longer side, 0 to always decode at full size
+     * @param cache    -- Result cache looked up before decoding, or nullptr
+     */
+    PhotoPrefetcher(const std::vector<boost::filesystem::path> &photos, const unsigned int threads,
+                    const size_t depth, const int max_size, const PhotoResultCache *cache = nullptr)
+        : mPhotos(photos), mDepth((std::max)(depth, size_t(1))), mMaxSize(max_size), mCache(cache),
+        mClaimed(0), mNext(0), mStop(false)
+    {
+        for (unsigned int t = 0; t < (std::max)(threads, 1u); t++)
+        {
+            mThreads.push_back(std::thread(&PhotoPrefetcher::run, this));
+        }
+    }
+
+    PhotoPrefetcher(const PhotoPrefetcher&) = delete;
+    PhotoPrefetcher& operator=(const PhotoPrefetcher&) = delete;
+
+    ~PhotoPrefetcher()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            mStop = true;
+        }
+        mSpace.notify_all();
+        for (std::thread &t : mThreads) t.join();
+    }
+
+    /** @brief Next blocks until the next photo in list order is decoded (or found in the cache)
+     * @param index -- Receives its position in the list
+     * @param photo -- Receives the image or the cached results
+     * @return false once every photo has been handed out
+     */
+    bool next(size_t &index, Photo &photo)
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        if (mNext >= mPhotos.size()) return false;
+        mReady.wait(lk, [this] { return mDecoded.count(mNext) > 0; });
+
+        index = mNext++;
+        std::swap(photo, mDecoded[index]);
+        mDecoded.erase(index);
+        lk.unlock();
+        mSpace.notify_all();
+        return true;
+    }
+
+    /** @brief JpegSize reads the dimensions from the SOF header of an in-memory JPEG
+     * @return false if data is not a JPEG (or the header could not be found)
+     */
+    static bool jpegSize(const std::vector<uchar> &data, int &width, int &height)
+    {
+        if (data.size() < 4 || data[0] != 0xFF || data[1] != 0xD8) return false;
+        size_t pos = 2;
+        while (pos + 9 < data.size())
+        {
+            if (data[pos] != 0xFF) return false;
+            const uchar marker = data[pos + 1];
+            if (marker == 0xFF) { pos++; continue; }    // fill byte
+            if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+            {
+                height = (data[pos + 5] << 8) | data[pos + 6];
+                width = (data[pos + 7] << 8) | data[pos + 8];
+                return true;
+            }
+            pos += 2 + ((data[pos + 2] << 8) | data[pos + 3]);
+        }
+        return false;
+    }
+
+private:
+
+    void run()
+    {
+        TRACE_THREAD_NAME("photo decode");
+        for (;;)
+        {
+            const size_t index = mClaimed++;
+            if (index >= mPhotos.size()) return;
+            {
+                std::unique_lock<std::mutex> lk(mMutex);
+                mSpace.wait(lk, [this, index] { return index < mNext + mDepth || mStop; });
+                if (mStop) return;
+            }
+
+            Photo photo;
+            {
+                TRACE_SCOPE("photo.decode");
+                decode(mPhotos[index], photo);
+            }
+            {
+                std::lock_guard<std::mutex> lg(mMutex);
+                std::swap(mDecoded[index], photo);
+            }
+            mReady.notify_one();
+        }
+    }
+
+    void decode(const boost::filesystem::path &path, Photo &photo) const
+    {
+        std::ifstream in(path.string().c_str(), std::ios::binary);
+        const std::vector<uchar> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (data.empty()) return;
+
+        if (mCache)
+        {
+            photo.key = mCache->key(data);
+            photo.cached = mCache->load(photo.key, photo.records);
+            if (photo.cached) return;
+        }
+
+        cv::Mat &image = photo.image;
+#ifdef PHOTO_PREFETCHER_REDUCED_DECODE
+        int width, height;
+        if (mMaxSize > 0 && jpegSize(data, width, height))
+        {
+            const int scale = reduction((std::max)(width, height));
+            if (scale > 1)
+            {
+                image = cv::imdecode(data, scale == 2 ? cv::IMREAD_REDUCED_COLOR_2
+                                         : scale == 4 ? cv::IMREAD_REDUCED_COLOR_4 : cv::IMREAD_REDUCED_COLOR_8);
+            }
+        }
+#endif
+        if (image.empty()) image = cv::imdecode(data, CV_LOAD_IMAGE_COLOR);
+        if (image.empty()) return;
+
+        // Formats without a reduced decoder (and older OpenCV) are shrunk after decoding
+        const int scale = reduction((std::max)(image.cols, image.rows));
+        if (scale > 1)
+        {
+            cv::resize(image, image, cv::Size(image.cols / scale, image.rows / scale), 0, 0, cv::INTER_AREA);
+        }
+    }
+
+    /** @brief Reduction picks the power of two (up to 8) that brings size closest to, but not below, mMaxSize
+     */
+    int reduction(const int size) const
+    {
+        int scale = 1;
+        while (mMaxSize > 0 && scale < 8 && size / (scale * 2) >= mMaxSize) scale *= 2;
+        return scale;
+    }
+
+    const std::vector<boost::filesystem::path> mPhotos;
+    const size_t mDepth;
+    const int mMaxSize;
+    const PhotoResultCache *mCache;
+    std::atomic<size_t> mClaimed;
+    size_t mNext;                           // next index handed out, guarded by mMutex
+    bool mStop;
+    std::map<size_t, Photo> mDecoded;       // decoded, not yet handed out
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    std::condition_variable mSpace;
+    std::vector<std::thread> mThreads;
+};
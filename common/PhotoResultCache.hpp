@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <boost/filesystem.hpp>
+
+#include "FaceRecord.hpp"
+#include "FrameResult.hpp"
+
+/** @brief On-disk cache of photo results, keyed by a hash of the photo's bytes and of the detector settings.
+ *  Each entry is one small binary file in the cache directory holding the photo's FaceRecords, so a hit skips both
+ *  decoding and detection. Entries are written to a temporary name and renamed into place, which makes the cache
+ *  safe to share between threads and processes. The settings string must change whenever the results would
+ *  (face detector mode, number of faces, classifiers, decode size...).
+ */
+class PhotoResultCache
+{
+public:
+
+    /** @param dir      -- Cache directory, created if needed
+     * @param settings -- Description of everything besides the photo that the results depend on
+     */
+    PhotoResultCache(const boost::filesystem::path &dir, const std::string &settings)
+        : mDir(dir), mSettingsHash(contentHash((const uchar *)settings.data(), settings.size(), 0))
+    {
+        boost::filesystem::create_directories(mDir);
+    }
+
+    /** @brief Key hashes the encoded photo together with the settings
+     */
+    uint64_t key(const std::vector<uchar> &data) const
+    {
+        return contentHash(data.data(), data.size(), mSettingsHash);
+    }
+
+    /** @brief Load reads the records stored for key. Their timestamps are the ones of the run that stored them.
+     * @return false on a miss (or an entry written by an incompatible build)
+     */
+    bool load(const uint64_t key, std::vector<FaceRecord> &records) const
+    {
+        std::ifstream in(entryPath(key).c_str(), std::ios::binary);
+        if (!in.is_open()) return false;
+
+        EntryHeader header;
+        if (!in.read((char *)&header, sizeof(header)) || memcmp(header.magic, entryMagic(), sizeof(header.magic)) != 0
+            || header.recordSize != sizeof(FaceRecord) || header.key != key)
+        {
+            return false;
+        }
+        records.resize(header.count);
+        return header.count == 0 || (bool)in.read((char *)records.data(), header.count * sizeof(FaceRecord));
+    }
+
+    /** @brief Store saves the faces found in the photo of key
+     */
+    void store(const uint64_t key, const FaceRange &faces, const double timeStamp) const
+    {
+        std::vector<FaceRecord> records;
+        for (const Face &f : faces) records.push_back(FaceRecord(timeStamp, f));
+
+        EntryHeader header;
+        memcpy(header.magic, entryMagic(), sizeof(header.magic));
+        header.recordSize = sizeof(FaceRecord);
+        header.count = (uint32_t)records.size();
+        header.reserved = 0;
+        header.key = key;
+
+        const boost::filesystem::path path = entryPath(key);
+        const boost::filesystem::path tmp = path.string() + "." + boost::filesystem::unique_path().string();
+        {
+            std::ofstream out(tmp.c_str(), std::ios::binary);
+            out.write((const char *)&header, sizeof(header));
+            if (!records.empty()) out.write((const char *)records.data(), records.size() * sizeof(FaceRecord));
+            if (!out) return;
+        }
+        boost::system::error_code ec;
+        boost::filesystem::rename(tmp, path, ec);
+        if (ec) boost::filesystem::remove(tmp, ec);
+    }
+
+    /** @brief ContentHash is a fast non-cryptographic 64-bit hash, four independent lanes over 32-byte blocks
+     */
+    static uint64_t contentHash(const uchar *data, const size_t size, const uint64_t seed)
+    {
+        const uint64_t K = 0x9E3779B97F4A7C15ull;
+        uint64_t lanes[4] = { seed ^ K, seed + K, seed ^ (K << 1), seed - K };
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32)
+        {
+            for (int l = 0; l < 4; l++)
+            {
+                uint64_t w;
+                memcpy(&w, data + i + 8 * l, 8);
+                lanes[l] = mix(lanes[l] ^ w);
+            }
+        }
+        uint64_t h = size * K;
+        for (int l = 0; l < 4; l++) h = mix(h ^ lanes[l]);
+        for (; i < size; i++) h = mix(h ^ data[i]);
+        return h;
+    }
+
+private:
+
+    static const char *entryMagic() { return "AFXR"; }
+
+    struct EntryHeader
+    {
+        char magic[4];
+        uint32_t recordSize;    // sizeof(FaceRecord) of the build that wrote it
+        uint32_t count;
+        uint32_t reserved;
+        uint64_t key;
+    };
+
+    static uint64_t mix(uint64_t x)
+    {
+        x ^= x >> 32;
+        x *= 0xD6E8FEB86659FD93ull;
+        x ^= x >> 32;
+        return x;
+    }
+
+    boost::filesystem::path entryPath(const uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.afxr", (unsigned long long)key);
+        return mDir / name;
+    }
+
+    const boost::filesystem::path mDir;
+    const uint64_t mSettingsHash;
+};
@@ -5,56 +5,184 @@
 #include <memory>
 #include <chrono>
 #include <thread>
+#include <atomic>
 #include <mutex>
+#include <condition_variable>
 #include <fstream>
 #include <boost/filesystem.hpp>
 #include <boost/timer/timer.hpp>
 
 #include "Visualizer.h"
 #include "ImageListener.h"
+#include "SpscRing.hpp"
+#include "FrameResult.hpp"
+#include "FaceRecord.hpp"
+#include "AsyncResultWriter.hpp"
+#include "CsvRowFormatter.hpp"
+#include "ColumnarResultEncoder.hpp"
+#include "LatestFrameRenderer.hpp"
+#include "AsyncVideoWriter.hpp"
+#include "FrameClock.hpp"
+#include "LatencyHistogram.hpp"
+#include "ThroughputStats.hpp"
+#include "PrometheusText.hpp"
+#include "TraceRecorder.hpp"
 
 using namespace affdex;
 
 class PlottingImageListener : public ImageListener
 {
+public:
+
+    /** @brief Output file formats. COLUMNAR is the binary format read by ColumnarResultReader.
+     */
+    enum class OutputFormat { CSV, COLUMNAR };
+
+    /** @brief Move-only handle on the oldest pending result, together with the smoothed (EWMA) frame rates when it
+     *  was taken.
+     *  The slot belongs to the consumer until release() (or the next acquireResult()), after which the listener
+     *  refills it in place.
+     */
+    class ResultLease
+    {
+    public:
+        ResultLease() : captureFPS(-1.0f), processFPS(-1.0f), mOwner(nullptr), mResult(nullptr) {}
+        ResultLease(ResultLease &&other)
+            : captureFPS(other.captureFPS), processFPS(other.processFPS), mOwner(other.mOwner), mResult(other.mResult)
+        {
+            other.mResult = nullptr;
+        }
+        ResultLease &operator=(ResultLease &&other)
+        {
+            if (this != &other)
+            {
+                release();
+                captureFPS = other.captureFPS;
+                processFPS = other.processFPS;
+                mOwner = other.mOwner;
+                mResult = other.mResult;
+                other.mResult = nullptr;
+            }
+            return *this;
+        }
+        ResultLease(const ResultLease &) = delete;
+        ResultLease &operator=(const ResultLease &) = delete;
+        ~ResultLease() { release(); }
+
+        /** @brief Release hands the slot back to the listener. Must happen on the consumer thread.
+         */
+        void release()
+        {
+            if (mResult)
+            {
+                mOwner->mResults.commitRead();
+                mResult = nullptr;
+            }
+        }
 
-    std::mutex mMutex;
-    std::deque<std::pair<Frame, std::map<FaceId, Face> > > mDataArray;
+        Frame &frame() { return mResult->frame; }
+        FaceRange faces() const { return mResult->faces(); }
 
-    double mCaptureLastTS;
-    double mCaptureFPS;
-    double mProcessLastTS;
-    double mProcessFPS;
-    std::ofstream &fStream;
-    std::chrono::time_point<std::chrono::system_clock> mStartT;
+        /** @brief Sequence number of the frame, when the listener has a FrameTimeline
+         */
+        uint64_t sequence() const { return mResult->stamp.sequence; }
+
+        /** @brief LatencyNanos is the time from capture to result delivery, -1 if the frame was not stamped
+         */
+        int64_t latencyNanos() const
+        {
+            return mResult->stamp.captureNs < 0 ? -1 : mResult->resultNs - mResult->stamp.captureNs;
+        }
+
+        double captureFPS;
+        double processFPS;
+
+    private:
+        friend class PlottingImageListener;
+        PlottingImageListener *mOwner;
+        FrameResult *mResult;
+    };
+
+private:
+
+    // Filled in place by the SDK callback thread, drained by the application's main loop.
+    SpscRing<FrameResult> mResults;
+    std::atomic<unsigned long long> mDroppedResults;
+    std::atomic<unsigned long long> mPoolAllocations;
+
+    // Lets the consumer sleep until a result arrives. The producer only touches the mutex when a consumer is waiting.
+    std::mutex mWaitMutex;
+    std::condition_variable mResultReady;
+    std::atomic<bool> mConsumerWaiting;
+    bool mWakeRequested;
+
+    // Frames entering the detector (onImageCapture) are counted as submitted, results as processed. The application
+    // records the frames it captures itself.
+    ThroughputStats mThroughput;
+    const FrameTimeline *mTimeline;
+    std::atomic<unsigned int> mFacesTracked;    // faces in the latest result
+
+    // Per-stage latencies, recorded from whichever thread runs the stage and drained by reportLatencies()
+    LatencyHistogram mCaptureToResult;    // frame capture to onImageResults, needs a FrameTimeline
+    LatencyHistogram mResultInterval;     // between consecutive onImageResults
+    LatencyHistogram mQueueWait;          // onImageResults to acquireResult
+    LatencyHistogram mDrawTime;           // draw() on the render thread
+    LatencyHistogram mWriteTime;          // encoding and writing a batch of rows
     const bool mDrawDisplay;
     const int spacing = 20;
     const float font_size = 0.5f;
     const int font = cv::FONT_HERSHEY_COMPLEX_SMALL;
     Visualizer viz;
+    AsyncResultWriter mWriter;
+    std::vector<FaceRecord> mRecords;    // scratch buffer reused by outputToFile
+    std::unique_ptr<AsyncVideoWriter> mVideoOut;      // annotated video export, fed by the render thread
+    // Drawn frames on their way from the render thread to the main thread, which alone may call HighGUI.
+    // The three images rotate: draw() fills mDrawnBack and swaps it with mDrawn, showLatest() swaps mDrawn with mShown.
+    cv::Mat mDrawnBack;        // render thread only
+    cv::Mat mDrawn;            // guarded by mDrawnMutex
+    cv::Mat mShown;            // main thread only
+    bool mDrawnFresh;          // mDrawn has not been shown yet, guarded by mDrawnMutex
+    std::mutex mDrawnMutex;
+    std::unique_ptr<LatestFrameRenderer> mRenderer;    // owns viz once started, declared last so it stops first
 
 public:
 
 
-    PlottingImageListener(std::ofstream &csv, const bool draw_display)
-        : fStream(csv), mDrawDisplay(draw_display), mStartT(std::chrono::system_clock::now()),
-        mCaptureLastTS(-1.0f), mCaptureFPS(-1.0f),
-        mProcessLastTS(-1.0f), mProcessFPS(-1.0f)
+    PlottingImageListener(std::ofstream &csv, const bool draw_display,
+                          const OutputFormat format = OutputFormat::CSV, const size_t queue_capacity = 256)
+        : mDrawDisplay(draw_display),
+        mResults(queue_capacity), mDroppedResults(0), mPoolAllocations(0), mConsumerWaiting(false), mWakeRequested(false),
+        mTimeline(nullptr), mFacesTracked(0),
+        mWriter(csv, makeEncoder(format), &mWriteTime), mDrawnFresh(false)
     {
+        if (mDrawDisplay)
+        {
+            startRenderer();
+        }
+    }
 
-        fStream << "TimeStamp,faceId,interocularDistance,glasses,age,ethnicity,gender,dominantEmoji,";
-        for (std::string angle : viz.HEAD_ANGLES) fStream << angle << ",";
-        for (std::string emotion : viz.EMOTIONS) fStream << emotion << ",";
-        for (std::string expression : viz.EXPRESSIONS) fStream << expression << ",";
-        for (std::string emoji : viz.EMOJIS) fStream << emoji << ",";
-        fStream << std::endl;
-        fStream.precision(4);
-        fStream << std::fixed;
+    /** @brief SetTimeline lets the listener recover the sequence number and capture time of the frames stamped by
+     *  timeline, for exact capture frame rates and capture-to-result latencies. Call before processing starts.
+     */
+    void setTimeline(const FrameTimeline *timeline)
+    {
+        mTimeline = timeline;
     }
 
-    cv::Point2f minPoint(VecFeaturePoint points)
+    /** @brief ExportVideo also writes every rendered frame, with the overlay, to a video file. Needs no display, so it
+     *  works with draw_display false. Call before processing starts.
+     * @param path -- Output file (MJPG, so .avi)
+     * @param fps  -- Frame rate of the output video
+     */
+    void exportVideo(const std::string &path, const double fps)
     {
-        VecFeaturePoint::iterator it = points.begin();
+        mVideoOut.reset(new AsyncVideoWriter(path, fps));
+        if (!mRenderer) startRenderer();
+    }
+
+    cv::Point2f minPoint(const VecFeaturePoint &points)
+    {
+        VecFeaturePoint::const_iterator it = points.begin();
         FeaturePoint ret = *it;
         for (; it != points.end(); it++)
         {
@@ -64,9 +192,9 @@ public:
         return cv::Point2f(ret.x, ret.y);
     };
 
-    cv::Point2f maxPoint(VecFeaturePoint points)
+    cv::Point2f maxPoint(const VecFeaturePoint &points)
     {
-        VecFeaturePoint::iterator it = points.begin();
+        VecFeaturePoint::const_iterator it = points.begin();
         FeaturePoint ret = *it;
         for (; it != points.end(); it++)
         {
@@ -77,108 +205,322 @@ public:
     };
 
 
+    /** @brief GetProcessingFrameRate returns the smoothed (EWMA) rate of results
+     */
     double getProcessingFrameRate()
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        return mProcessFPS;
+        return mThroughput.processedMeter().ewma(steadyNanos());
     }
 
+    /** @brief GetCaptureFrameRate returns the smoothed (EWMA) rate of frames entering the detector
+     */
     double getCaptureFrameRate()
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        return mCaptureFPS;
+        return mThroughput.submittedMeter().ewma(steadyNanos());
+    }
+
+    /** @brief Throughput gives access to the frame counters and rates, the application records its captures there
+     */
+    ThroughputStats &throughput()
+    {
+        return mThroughput;
     }
 
     int getDataSize()
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        return mDataArray.size();
+        return mResults.size();
+    }
+
+    /** @brief Number of results discarded because the consumer fell a full queue behind
+     */
+    unsigned long long getDroppedCount()
+    {
+        return mDroppedResults.load(std::memory_order_relaxed);
+    }
 
+    /** @brief Number of results whose copy into the result ring allocated, because a slot's face pool or one of its
+     *  pooled faces' feature points had to grow. Stops increasing once the pool has warmed up, after which the result
+     *  hand-off performs no heap allocation of its own.
+     */
+    unsigned long long getPoolAllocationCount()
+    {
+        return mPoolAllocations.load(std::memory_order_relaxed);
     }
 
-    std::pair<Frame, std::map<FaceId, Face>> getData()
+    /** @brief AcquireResult releases whatever out was holding and leases the oldest pending result, with the current
+     *  frame rates, in a single call
+     * @param out -- Receives the lease, left empty if nothing is pending
+     * @return true if a result was available
+     */
+    bool acquireResult(ResultLease &out)
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        std::pair<Frame, std::map<FaceId, Face>> dpoint = mDataArray.front();
-        mDataArray.pop_front();
-        return dpoint;
+        out.release();
+        FrameResult *result = mResults.readSlot();
+        if (!result) return false;
+        const int64_t now = steadyNanos();
+        mQueueWait.record(now - result->resultNs);
+        if (result->stamp.captureNs >= 0) TRACE_FRAME_SPAN("queued", result->stamp.sequence, result->resultNs, now);
+        out.mOwner = this;
+        out.mResult = result;
+        out.captureFPS = getCaptureFrameRate();
+        out.processFPS = getProcessingFrameRate();
+        return true;
+    }
+
+    /** @brief ReportThroughput prints the frame counts and their rates over 1s, 10s and 60s and smoothed
+     */
+    void reportThroughput(std::ostream &out)
+    {
+        out << mThroughput.report();
+    }
+
+    /** @brief ReportLatencies prints p50/p90/p99/max of every stage since the previous report, one line per stage
+     */
+    void reportLatencies(std::ostream &out)
+    {
+        out << LatencyHistogram::format("capture->result", mCaptureToResult.drain()) << std::endl
+            << LatencyHistogram::format("result interval", mResultInterval.drain()) << std::endl
+            << LatencyHistogram::format("queue wait", mQueueWait.drain()) << std::endl
+            << LatencyHistogram::format("draw", mDrawTime.drain()) << std::endl
+            << LatencyHistogram::format("write", mWriteTime.drain()) << std::endl;
+    }
+
+    /** @brief CollectMetrics writes the frame counters and rates, queue depths, tracked faces and stage latencies in
+     *  the Prometheus format, for a MetricsExporter. Safe to call from any thread. The frame counters restart when
+     *  retargetOutput() moves on to the next file.
+     */
+    void collectMetrics(PrometheusText &out)
+    {
+        const int64_t now = steadyNanos();
+        const RateMeter *meters[] = { &mThroughput.capturedMeter(), &mThroughput.submittedMeter(), &mThroughput.processedMeter() };
+        const uint64_t totals[] = { mThroughput.capturedCount(), mThroughput.submittedCount(), mThroughput.processedCount() };
+        const char *stages[] = { "captured", "submitted", "processed" };
+        out.family("affdex_frames_total", "counter", "Frames captured by the application, submitted to the detector and processed by it.");
+        for (int m = 0; m < 3; m++)
+        {
+            out.sample("affdex_frames_total", (double)totals[m], PrometheusText::label("stage", stages[m]));
+        }
+        out.family("affdex_frames_per_second", "gauge", "Frame rate of each stage, exponentially weighted over 5 seconds.");
+        for (int m = 0; m < 3; m++)
+        {
+            out.sample("affdex_frames_per_second", meters[m]->ewma(now), PrometheusText::label("stage", stages[m]));
+        }
+        out.counter("affdex_frames_dropped_total", "Frames dropped because a later stage fell behind.", (double)mThroughput.droppedCount());
+        out.counter("affdex_display_skipped_total", "Results replaced by a newer one before being drawn.", (double)getSkippedDisplayCount());
+        out.counter("affdex_export_dropped_total", "Rendered frames left out of the exported video.", (double)getExportDroppedCount());
+
+        out.family("affdex_queue_depth", "gauge", "Items waiting in the listener's queues.");
+        out.sample("affdex_queue_depth", (double)mResults.size(), PrometheusText::label("queue", "results"));
+        out.sample("affdex_queue_depth", (double)mWriter.pendingCount(), PrometheusText::label("queue", "output_rows"));
+        out.gauge("affdex_faces_tracked", "Faces in the latest result.", mFacesTracked.load(std::memory_order_relaxed));
+
+        out.family("affdex_stage_latency_seconds", "histogram", "Latency of each pipeline stage.");
+        out.histogram("affdex_stage_latency_seconds", mCaptureToResult, PrometheusText::label("stage", "capture_to_result"));
+        out.histogram("affdex_stage_latency_seconds", mResultInterval, PrometheusText::label("stage", "result_interval"));
+        out.histogram("affdex_stage_latency_seconds", mQueueWait, PrometheusText::label("stage", "queue_wait"));
+        out.histogram("affdex_stage_latency_seconds", mDrawTime, PrometheusText::label("stage", "draw"));
+        out.histogram("affdex_stage_latency_seconds", mWriteTime, PrometheusText::label("stage", "write"));
+    }
+
+    /** @brief WaitForResult blocks the consumer until a result is pending, wakeConsumer() is called or the timeout expires
+     * @param timeout -- Maximum time to sleep
+     * @return true if a result is ready to be popped
+     */
+    template <class Rep, class Period>
+    bool waitForResult(const std::chrono::duration<Rep, Period> &timeout)
+    {
+        if (!mResults.empty()) return true;
+
+        std::unique_lock<std::mutex> lk(mWaitMutex);
+        mConsumerWaiting.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);    // pairs with the fence in notifyConsumer()
+        mResultReady.wait_for(lk, timeout, [this] { return !mResults.empty() || mWakeRequested; });
+        mConsumerWaiting.store(false, std::memory_order_relaxed);
+        mWakeRequested = false;
+        return !mResults.empty();
+    }
+
+    /** @brief WakeConsumer interrupts a pending waitForResult(), e.g. when processing has finished
+     */
+    void wakeConsumer()
+    {
+        {
+            std::lock_guard<std::mutex> lk(mWaitMutex);
+            mWakeRequested = true;
+        }
+        mResultReady.notify_all();
     }
 
     void onImageResults(std::map<FaceId, Face> faces, Frame image) override
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        mDataArray.push_back(std::pair<Frame, std::map<FaceId, Face>>(image, faces));
-        std::chrono::time_point<std::chrono::system_clock> now = std::chrono::system_clock::now();
-        std::chrono::milliseconds milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(now - mStartT);
-        double seconds = milliseconds.count() / 1000.f;
-        mProcessFPS = 1.0f / (seconds - mProcessLastTS);
-        mProcessLastTS = seconds;
+        TRACE_THREAD_NAME("sdk");
+        TRACE_SCOPE("onImageResults");
+        const int64_t now = steadyNanos();
+        const int64_t previous = mThroughput.processed(now);
+        if (previous >= 0) mResultInterval.record(now - previous);
+        mFacesTracked.store((unsigned int)faces.size(), std::memory_order_relaxed);
+
+        // Never wait for the consumer: if it is a whole queue behind, drop this result.
+        FrameResult *slot = mResults.writeSlot();
+        if (!slot)
+        {
+            mDroppedResults.fetch_add(1, std::memory_order_relaxed);
+            mThroughput.dropped();
+            return;
+        }
+        slot->stamp = FrameStamp();
+        if (mTimeline && mTimeline->find(image.getTimestamp(), slot->stamp))
+        {
+            mCaptureToResult.record(now - slot->stamp.captureNs);
+            TRACE_FRAME_SPAN("frame", slot->stamp.sequence, slot->stamp.captureNs, now);
+        }
+        slot->resultNs = now;
+        if (slot->assign(faces, image))
+        {
+            mPoolAllocations.fetch_add(1, std::memory_order_relaxed);
+        }
+        mResults.commitWrite();
+        notifyConsumer();
     };
 
     void onImageCapture(Frame image) override
     {
-        std::lock_guard<std::mutex> lg(mMutex);
-        mCaptureFPS = 1.0f / (image.getTimestamp() - mCaptureLastTS);
-        mCaptureLastTS = image.getTimestamp();
+        mThroughput.submitted();
     };
 
-    void outputToFile(const std::map<FaceId, Face> faces, const double timeStamp)
+    /** @brief OutputToFile queues one row per face (or a placeholder row if there are none).
+     *  Formatting and disk I/O happen on the writer thread.
+     */
+    void outputToFile(const FaceRange &faces, const double timeStamp)
     {
+        TRACE_SCOPE("outputToFile");
+        mRecords.clear();
         if (faces.empty())
         {
-            fStream << timeStamp << ",nan,nan,no,unknown,unknown,unknown,unknown,";
-            for (std::string angle : viz.HEAD_ANGLES) fStream << "nan,";
-            for (std::string emotion : viz.EMOTIONS) fStream << "nan,";
-            for (std::string expression : viz.EXPRESSIONS) fStream << "nan,";
-            for (std::string emoji : viz.EMOJIS) fStream << "nan,";
-            fStream << std::endl;
+            mRecords.push_back(FaceRecord(timeStamp));
         }
-        for (auto & face_id_pair : faces)
+        for (const Face &f : faces)
         {
-            Face f = face_id_pair.second;
+            mRecords.push_back(FaceRecord(timeStamp, f));
+        }
+        mWriter.append(mRecords);
+    }
 
-            fStream << timeStamp << ","
-                << f.id << ","
-                << f.measurements.interocularDistance << ","
-                << viz.GLASSES_MAP[f.appearance.glasses] << ","
-                << viz.AGE_MAP[f.appearance.age] << ","
-                << viz.ETHNICITY_MAP[f.appearance.ethnicity] << ","
-                << viz.GENDER_MAP[f.appearance.gender] << ","
-                << affdex::EmojiToString(f.emojis.dominantEmoji) << ",";
+    /** @brief OutputRecords queues previously computed rows (e.g. from a result cache) under a new timestamp
+     */
+    void outputRecords(const std::vector<FaceRecord> &records, const double timeStamp)
+    {
+        mRecords.assign(records.begin(), records.end());
+        if (mRecords.empty())
+        {
+            mRecords.push_back(FaceRecord(timeStamp));
+        }
+        for (FaceRecord &r : mRecords)
+        {
+            r.timestamp = timeStamp;
+        }
+        mWriter.append(mRecords);
+    }
 
-            float *values = (float *)&f.measurements.orientation;
-            for (std::string angle : viz.HEAD_ANGLES)
-            {
-                fStream << (*values) << ",";
-                values++;
-            }
+    /** @brief FlushOutput blocks until every queued row has reached the output stream
+     */
+    void flushOutput()
+    {
+        mWriter.flush();
+    }
 
-            values = (float *)&f.emotions;
-            for (std::string emotion : viz.EMOTIONS)
-            {
-                fStream << (*values) << ",";
-                values++;
-            }
+    /** @brief Display queues a copy of the result for the render thread, which draws the newest one. The drawn frame
+     *  reaches the screen on the next showLatest(). Never blocks on drawing.
+     */
+    void display(const FaceRange &faces, const Frame &image)
+    {
+        if (mRenderer) mRenderer->submit(faces, image);
+    }
 
-            values = (float *)&f.expressions;
-            for (std::string expression : viz.EXPRESSIONS)
-            {
-                fStream << (*values) << ",";
-                values++;
-            }
+    /** @brief ShowLatest puts the newest frame drawn since the last call on screen and lets HighGUI process window
+     *  events. HighGUI windows must be driven from the main thread (Cocoa refuses any other, GTK is not thread safe),
+     *  so call it from the main loop; the render thread only draws. Does nothing with draw_display false.
+     * @param wait -- First wait for the render thread to draw every result submitted so far, e.g. for a single photo
+     */
+    void showLatest(const bool wait = false)
+    {
+        if (!mDrawDisplay) return;
+        if (wait && mRenderer) mRenderer->waitIdle();
+        {
+            std::lock_guard<std::mutex> lg(mDrawnMutex);
+            if (!mDrawnFresh) return;
+            std::swap(mDrawn, mShown);
+            mDrawnFresh = false;
+        }
+        TRACE_SCOPE("showImage");
+        Visualizer::showImage(mShown);
+    }
 
-            values = (float *)&f.emojis;
-            for (std::string emoji : viz.EMOJIS)
-            {
-                fStream << (*values) << ",";
-                values++;
-            }
+    /** @brief Number of results that were never drawn because a newer one replaced them
+     */
+    unsigned long long getSkippedDisplayCount()
+    {
+        return mRenderer ? mRenderer->getSkippedCount() : 0;
+    }
 
-            fStream << std::endl;
-        }
+    /** @brief Number of rendered frames left out of the exported video because the encoder was a full queue behind
+     */
+    unsigned long long getExportDroppedCount()
+    {
+        return mVideoOut ? mVideoOut->getDroppedCount() : 0;
+    }
+
+    /** @brief StopDisplay stops the render thread and finalizes the exported video, if any
+     */
+    void stopDisplay()
+    {
+        if (mRenderer) mRenderer->stop();
+        if (mVideoOut) mVideoOut->close();
     }
 
-    std::vector<cv::Point2f> CalculateBoundingBox(VecFeaturePoint points)
+    /** @brief RetargetOutput finishes the current output file and continues in out, so one listener (and its warm
+     *  detector) can serve several input files. Call it between files, on the consumer thread, once every result of
+     *  the previous file has been drained.
+     */
+    void retargetOutput(std::ofstream &out)
+    {
+        mWriter.retarget(out);
+        mThroughput.reset();    // applied by each stage's own thread on its next frame
+    }
+
+    /** @brief CloseOutput writes the remaining rows and stops the writer thread. Call it after detector->stop().
+     */
+    void closeOutput()
+    {
+        mWriter.close();
+    }
+
+private:
+
+    std::unique_ptr<ResultEncoder> makeEncoder(const OutputFormat format)
+    {
+        if (format == OutputFormat::COLUMNAR) return std::unique_ptr<ResultEncoder>(new ColumnarResultEncoder());
+        return std::unique_ptr<ResultEncoder>(new CsvRowFormatter());
+    }
+
+    void startRenderer()
+    {
+        mRenderer.reset(new LatestFrameRenderer([this](const FaceRange &faces, Frame &image) { draw(faces, image); }));
+    }
+
+    void notifyConsumer()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);    // publish the push before reading the waiting flag
+        if (!mConsumerWaiting.load(std::memory_order_relaxed)) return;
+
+        // Taking the lock guarantees the consumer is either inside wait_for or will see the new result.
+        { std::lock_guard<std::mutex> lk(mWaitMutex); }
+        mResultReady.notify_one();
+    }
+
+public:
+
+    std::vector<cv::Point2f> CalculateBoundingBox(const VecFeaturePoint &points)
     {
 
         std::vector<cv::Point2f> ret;
@@ -199,8 +541,13 @@ public:
         return ret;
     }
 
-    void draw(const std::map<FaceId, Face> faces, Frame image)
+    /** @brief Draw renders the metrics over the frame, then hands it to showLatest() and/or queues it for the
+     *  exported video. Called on the render thread, see display().
+     */
+    void draw(const FaceRange &faces, Frame &image)
     {
+        TRACE_SCOPE("draw");
+        const int64_t start = steadyNanos();
 
         const int left_margin = 30;
 
@@ -211,14 +558,12 @@ public:
         cv::Mat img = cv::Mat(image.getHeight(), image.getWidth(), CV_8UC3, imgdata.get());
         viz.updateImage(img);
 
-        for (auto & face_id_pair : faces)
+        for (const Face &f : faces)
         {
-            Face f = face_id_pair.second;
-            VecFeaturePoint points = f.featurePoints;
-            std::vector<cv::Point2f> bounding_box = CalculateBoundingBox(points);
+            std::vector<cv::Point2f> bounding_box = CalculateBoundingBox(f.featurePoints);
 
             // Draw Facial Landmarks Points
-            //viz.drawPoints(points);
+            //viz.drawPoints(f.featurePoints);
 
             // Draw bounding box
             viz.drawBoundingBox(bounding_box[0], bounding_box[1], f.emotions.valence);
@@ -227,8 +572,20 @@ public:
             viz.drawFaceMetrics(f, bounding_box);
         }
 
-        viz.showImage();
-        std::lock_guard<std::mutex> lg(mMutex);
+        if (mDrawDisplay)
+        {
+            TRACE_SCOPE("display.publish");
+            img.copyTo(mDrawnBack);    // the frame buffer is reused for the next result
+            std::lock_guard<std::mutex> lg(mDrawnMutex);
+            std::swap(mDrawnBack, mDrawn);
+            mDrawnFresh = true;
+        }
+        if (mVideoOut)
+        {
+            TRACE_SCOPE("export.push");
+            mVideoOut->push(img);
+        }
+        mDrawTime.record(steadyNanos() - start);
     }
 
 };
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#include <tlhelp32.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#include <boost/filesystem.hpp>
+#endif
+
+#include "PrometheusText.hpp"
+
+/** @brief Resource usage of the running process: resident memory and CPU time, in total and per thread.
+ *  Read from the OS on every call (psapi and a toolhelp thread snapshot on Windows, /proc on Linux), so meant for
+ *  metric scrapes, not hot paths. Other platforms report nothing.
+ */
+class ProcessStats
+{
+public:
+
+    struct ThreadCpu
+    {
+        unsigned long id;
+        std::string name;
+        double seconds;     // user + system
+    };
+
+    /** @brief ResidentBytes returns the resident set size (the working set on Windows), 0 if unknown
+     */
+    static uint64_t residentBytes()
+    {
+#ifdef _WIN32
+        PROCESS_MEMORY_COUNTERS counters;
+        if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+        return counters.WorkingSetSize;
+#elif defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        uint64_t size = 0, resident = 0;
+        if (!(statm >> size >> resident)) return 0;
+        return resident * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+        return 0;
+#endif
+    }
+
+    /** @brief CpuSeconds returns the user + system time of the whole process, -1 if unknown
+     */
+    static double cpuSeconds()
+    {
+#ifdef _WIN32
+        FILETIME created, exited, kernel, user;
+        if (!GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user)) return -1;
+        return fileTimeSeconds(kernel) + fileTimeSeconds(user);
+#elif defined(__linux__)
+        std::string name;
+        double seconds;
+        return readStat("/proc/self/stat", name, seconds) ? seconds : -1;
+#else
+        return -1;
+#endif
+    }
+
+    /** @brief Threads lists the threads of the process with the CPU time each has used
+     */
+    static std::vector<ThreadCpu> threads()
+    {
+        std::vector<ThreadCpu> out;
+#ifdef _WIN32
+        const DWORD process = GetCurrentProcessId();
+        HANDLE snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+        if (snapshot == INVALID_HANDLE_VALUE) return out;
+        THREADENTRY32 entry;
+        entry.dwSize = sizeof(entry);
+        for (BOOL more = Thread32First(snapshot, &entry); more; more = Thread32Next(snapshot, &entry))
+        {
+            if (entry.th32OwnerProcessID != process) continue;
+            HANDLE thread = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, entry.th32ThreadID);
+            if (!thread) continue;
+            FILETIME created, exited, kernel, user;
+            if (GetThreadTimes(thread, &created, &exited, &kernel, &user))
+            {
+                ThreadCpu t = { entry.th32ThreadID, std::string(), fileTimeSeconds(kernel) + fileTimeSeconds(user) };
+                out.push_back(t);
+            }
+            CloseHandle(thread);
+        }
+        CloseHandle(snapshot);
+#elif defined(__linux__)
+        boost::system::error_code ec;
+        for (boost::filesystem::directory_iterator it("/proc/self/task", ec), end; !ec && it != end; it.increment(ec))
+        {
+            ThreadCpu t;
+            std::istringstream id(it->path().filename().string());
+            if (!(id >> t.id)) continue;
+            if (readStat((it->path() / "stat").string(), t.name, t.seconds)) out.push_back(t);
+        }
+#endif
+        return out;
+    }
+
+    /** @brief Collect writes the standard process_* metrics plus process_thread_cpu_seconds_total per thread
+     */
+    static void collect(PrometheusText &out)
+    {
+        const uint64_t resident = residentBytes();
+        if (resident > 0) out.gauge("process_resident_memory_bytes", "Resident memory size in bytes.", (double)resident);
+        const double cpu = cpuSeconds();
+        if (cpu >= 0) out.counter("process_cpu_seconds_total", "Total user and system CPU time spent in seconds.", cpu);
+
+        const std::vector<ThreadCpu> all = threads();
+        if (all.empty()) return;
+        out.family("process_thread_cpu_seconds_total", "counter", "User and system CPU time spent by each thread in seconds.");
+        for (const ThreadCpu &t : all)
+        {
+            std::string labels = PrometheusText::label("tid", std::to_string(t.id));
+            if (!t.name.empty()) labels += "," + PrometheusText::label("name", t.name);
+            out.sample("process_thread_cpu_seconds_total", t.seconds, labels);
+        }
+    }
+
+private:
+
+#ifdef _WIN32
+    static double fileTimeSeconds(const FILETIME &t)
+    {
+        return ((uint64_t(t.dwHighDateTime) << 32) | t.dwLowDateTime) * 1e-7;    // 100ns units
+    }
+#else
+    /** @brief ReadStat parses the name and utime + stime out of a /proc stat file. The name is in parentheses and
+     *  may itself contain spaces and parentheses, so fields are counted from the last ')'.
+     */
+    static bool readStat(const std::string &path, std::string &name, double &seconds)
+    {
+        std::ifstream in(path.c_str());
+        std::string line;
+        if (!std::getline(in, line)) return false;
+        const size_t open = line.find('(');
+        const size_t close = line.rfind(')');
+        if (open == std::string::npos || close == std::string::npos || close < open) return false;
+        name = line.substr(open + 1, close - open - 1);
+
+        std::istringstream fields(line.substr(close + 1));
+        std::string field;
+        unsigned long long utime = 0, stime = 0;
+        for (int f = 3; f <= 13 && (fields >> field); f++) {}    // state through cmajflt
+        if (!(fields >> utime >> stime)) return false;
+        seconds = (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+        return true;
+    }
+#endif
+};
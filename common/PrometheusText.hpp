@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "LatencyHistogram.hpp"
+
+/** @brief Builds a page in the Prometheus text exposition format (version 0.0.4).
+ *  Every metric family starts with family(), which writes its HELP and TYPE lines, followed by its samples. A family
+ *  must be written in one go: Prometheus rejects a page that repeats a family's header.
+ */
+class PrometheusText
+{
+public:
+
+    /** @brief Family starts a metric family
+     * @param type -- "counter", "gauge" or "histogram"
+     */
+    void family(const char *name, const char *type, const char *help)
+    {
+        mText += "# HELP ";
+        mText += name;
+        mText += ' ';
+        mText += help;
+        mText += "\n# TYPE ";
+        mText += name;
+        mText += ' ';
+        mText += type;
+        mText += '\n';
+    }
+
+    /** @param labels -- Comma separated label pairs built with label(), or empty
+     */
+    void sample(const char *name, const double value, const std::string &labels = std::string())
+    {
+        char number[32];
+        snprintf(number, sizeof(number), "%.15g", value);
+        mText += name;
+        if (!labels.empty())
+        {
+            mText += '{';
+            mText += labels;
+            mText += '}';
+        }
+        mText += ' ';
+        mText += number;
+        mText += '\n';
+    }
+
+    void counter(const char *name, const char *help, const double value)
+    {
+        family(name, "counter", help);
+        sample(name, value);
+    }
+
+    void gauge(const char *name, const char *help, const double value)
+    {
+        family(name, "gauge", help);
+        sample(name, value);
+    }
+
+    /** @brief Histogram writes the _bucket, _sum and _count samples of one histogram, in seconds. The family, of
+     *  type "histogram", must have been started by the caller.
+     */
+    void histogram(const char *name, const LatencyHistogram &histogram, const std::string &labels = std::string())
+    {
+        static const double BOUNDS[] = { 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+        const size_t count = sizeof(BOUNDS) / sizeof(BOUNDS[0]);
+        std::vector<int64_t> bounds(count);
+        for (size_t b = 0; b < count; b++) bounds[b] = (int64_t)(BOUNDS[b] * 1e9);
+
+        std::vector<uint64_t> counts;
+        uint64_t sum;
+        const uint64_t total = histogram.cumulative(bounds, counts, sum);
+
+        const std::string bucket = std::string(name) + "_bucket";
+        const std::string prefix = labels.empty() ? labels : labels + ",";
+        char le[32];
+        for (size_t b = 0; b < count; b++)
+        {
+            snprintf(le, sizeof(le), "%g", BOUNDS[b]);
+            sample(bucket.c_str(), (double)counts[b], prefix + label("le", le));
+        }
+        sample(bucket.c_str(), (double)total, prefix + label("le", "+Inf"));
+        sample((std::string(name) + "_sum").c_str(), sum / 1e9, labels);
+        sample((std::string(name) + "_count").c_str(), (double)total, labels);
+    }
+
+    /** @brief Label renders key="value", escaping the value
+     */
+    static std::string label(const char *key, const std::string &value)
+    {
+        std::string out(key);
+        out += "=\"";
+        for (const char c : value)
+        {
+            if (c == '\\') out += "\\\\";
+            else if (c == '"') out += "\\\"";
+            else if (c == '\n') out += "\\n";
+            else out += c;
+        }
+        return out + "\"";
+    }
+
+    const std::string &str() const
+    {
+        return mText;
+    }
+
+private:
+
+    std::string mText;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <ostream>
+
+#include "FaceRecord.hpp"
+
+/** @brief Serializes FaceRecords for AsyncResultWriter.
+ *  Rows are buffered in memory by append() and only reach the stream on flush(), both called from the writer thread.
+ */
+class ResultEncoder
+{
+public:
+    virtual ~ResultEncoder() {}
+
+    /** @brief WriteHeader emits whatever precedes the first row (column names, schema...)
+     */
+    virtual void writeHeader(std::ostream &out) = 0;
+
+    /** @brief Append buffers one row
+     */
+    virtual void append(const FaceRecord &record) = 0;
+
+    /** @brief Number of bytes currently buffered
+     */
+    virtual size_t bufferedBytes() const = 0;
+
+    /** @brief Flush writes all buffered rows to out
+     */
+    virtual void flush(std::ostream &out) = 0;
+};
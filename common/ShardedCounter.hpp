@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+/** @brief Event counter for hot paths written from several threads.
+ *  Each thread increments its own shard with a relaxed atomic add, so writers never share a line with each other;
+ *  a read sums the shards and so pulls every written line, which is fine for reports but not for hot paths.
+ *  A counter with a single writer gains nothing from sharding, a plain atomic does as well.
+ */
+class ShardedCounter
+{
+public:
+
+    static const size_t SHARDS = 16;
+
+    ShardedCounter()
+    {
+        reset();
+    }
+
+    ShardedCounter(const ShardedCounter&) = delete;
+    ShardedCounter& operator=(const ShardedCounter&) = delete;
+
+    void add(const uint64_t n = 1)
+    {
+        mShards[shardIndex()].value.fetch_add(n, std::memory_order_relaxed);
+    }
+
+    /** @brief Value returns the sum of the shards, increments racing with the read may or may not be included
+     */
+    uint64_t value() const
+    {
+        uint64_t sum = 0;
+        for (const Shard &shard : mShards) sum += shard.value.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+    void reset()
+    {
+        for (Shard &shard : mShards) shard.value.store(0, std::memory_order_relaxed);
+    }
+
+private:
+
+    // Padded rather than aligned: shards 64 bytes apart never share a cache line, without needing an over-aligned new
+    struct Shard
+    {
+        std::atomic<uint64_t> value;
+        char padding[64 - sizeof(std::atomic<uint64_t>)];
+    };
+
+    /** @brief ShardIndex: threads are given shards round-robin the first time they count anything
+     */
+    static size_t shardIndex()
+    {
+        static std::atomic<size_t> nextThread(0);
+        thread_local const size_t index = nextThread.fetch_add(1, std::memory_order_relaxed) % SHARDS;
+        return index;
+    }
+
+    Shard mShards[SHARDS];
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/** @brief Fixed-capacity, lock-free single-producer/single-consumer ring buffer whose elements are updated in place.
+ *  Exactly one thread may write and exactly one (other) thread may read. Neither side ever blocks:
+ *  writeSlot() on a full ring and readSlot() on an empty ring return nullptr immediately.
+ */
+template <typename T>
+class SpscRing
+{
+public:
+
+    /** @param capacity -- Minimum number of elements the ring can hold (rounded up to a power of two)
+     */
+    explicit SpscRing(const size_t capacity)
+        : mSlots(roundUpPow2(capacity)), mMask(mSlots.size() - 1), mHead(0), mTail(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /** @brief WriteSlot exposes the slot the next push will fill so it can be updated in place (producer thread only)
+     * @return nullptr if the ring is full
+     */
+    T* writeSlot()
+    {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail - mHead.load(std::memory_order_acquire) == mSlots.size()) return nullptr;
+        return &mSlots[tail & mMask];
+    }
+
+    /** @brief CommitWrite publishes the slot returned by writeSlot() to the consumer
+     */
+    void commitWrite()
+    {
+        mTail.store(mTail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** @brief ReadSlot exposes the oldest element without removing it (consumer thread only)
+     * @return nullptr if the ring is empty
+     */
+    T* readSlot()
+    {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head == mTail.load(std::memory_order_acquire)) return nullptr;
+        return &mSlots[head & mMask];
+    }
+
+    /** @brief CommitRead hands the slot returned by readSlot() back to the producer. The element is not destroyed,
+     *  so whatever storage it owns is reused by the next writeSlot() that lands on it.
+     */
+    void commitRead()
+    {
+        mHead.store(mHead.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /** @brief Size returns the number of queued elements. Exact only when called from the producer or consumer.
+     */
+    size_t size() const
+    {
+        const size_t head = mHead.load(std::memory_order_acquire);
+        return mTail.load(std::memory_order_acquire) - head;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return mSlots.size(); }
+
+private:
+
+    static size_t roundUpPow2(size_t n)
+    {
+        size_t p = 1;
+        while (p < n) p <<= 1;
+        return p;
+    }
+
+    static const size_t CACHE_LINE = 64;
+
+    std::vector<T> mSlots;
+    const size_t mMask;
+
+    // Head (consumer) and tail (producer) live on separate cache lines so the two threads don't false-share.
+    char mPad0[CACHE_LINE];
+    std::atomic<size_t> mHead;
+    char mPad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> mTail;
+    char mPad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+};
@@ -6,6 +6,7 @@
 #include <thread>
 #include <mutex>
 #include <fstream>
+#include <functional>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <boost/filesystem.hpp>
@@ -22,6 +23,10 @@ class StatusListener : public ProcessStatusListener
 public:
     
     StatusListener():mIsRunning(true) {};
+
+    /** @param on_stopped -- Invoked (on the SDK thread) once processing has finished or failed
+     */
+    StatusListener(std::function<void()> on_stopped):mIsRunning(true), mOnStopped(on_stopped) {};
     
     void onProcessingException(AffdexException ex)
     {
@@ -29,6 +34,7 @@ public:
         m.lock();
         mIsRunning = false;
         m.unlock();
+        if (mOnStopped) mOnStopped();
     };
     
     void onProcessingFinished()
@@ -37,7 +43,8 @@ public:
         m.lock();
         mIsRunning = false;
         m.unlock();
-        
+        if (mOnStopped) mOnStopped();
+
     };
     
     bool isRunning()
@@ -52,5 +59,6 @@ public:
 private:
     std::mutex m;
     bool mIsRunning;
+    std::function<void()> mOnStopped;
     
 };
@@ -0,0 +1,214 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "FrameClock.hpp"
+#include "ShardedCounter.hpp"
+
+/** @brief Event rate over sliding windows plus an exponentially weighted moving average.
+ *  Events are counted in one-second buckets covering the last minute, so windowed rates cost nothing to keep and
+ *  cover whole seconds (the current, partial second is left out). The EWMA follows the instantaneous rate with a
+ *  time constant of EWMA_SECONDS, weighted by the time between events so bursts and gaps are averaged correctly.
+ *  A meter has a single writer, the thread of the stage it measures, which publishes everything through atomics:
+ *  reading and reset() are safe from any thread and never make the writer wait.
+ */
+class RateMeter
+{
+public:
+
+    static const int WINDOW_SECONDS = 60;
+    static constexpr double EWMA_SECONDS = 5.0;
+
+    RateMeter() : mResetRequests(0), mResetsApplied(0)
+    {
+        clear();
+    }
+
+    RateMeter(const RateMeter&) = delete;
+    RateMeter& operator=(const RateMeter&) = delete;
+
+    /** @brief Reset forgets every event. Callable from any thread: it only asks the writer, which clears the meter
+     *  before recording its next event. Reads return zero meanwhile.
+     */
+    void reset()
+    {
+        mResetRequests.fetch_add(1, std::memory_order_release);
+    }
+
+    /** @brief Record counts one event that happened at steadyNanos() time ns. Only ever called by the writer.
+     * @return Time of the previous event, -1 if there was none since the meter was created or reset
+     */
+    int64_t record(const int64_t ns)
+    {
+        const uint32_t requested = mResetRequests.load(std::memory_order_acquire);
+        if (requested != mResetsApplied.load(std::memory_order_relaxed))
+        {
+            clear();
+            mResetsApplied.store(requested, std::memory_order_release);
+        }
+
+        // A bucket packs its second (modulo 2^32) in the high half and that second's count in the low half, so
+        // readers never see the count of one second under the label of another.
+        const int64_t second = ns / 1000000000LL;
+        std::atomic<uint64_t> &bucket = mBuckets[second % BUCKETS];
+        const uint64_t tag = (uint64_t)(uint32_t)second << 32;
+        const uint64_t word = bucket.load(std::memory_order_relaxed);
+        bucket.store((word & ~COUNT_MASK) == tag ? word + 1 : tag | 1, std::memory_order_relaxed);
+        mTotal.store(mTotal.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+        const int64_t last = mLastNs.load(std::memory_order_relaxed);
+        if (last >= 0 && ns > last)
+        {
+            const double dt = (ns - last) * 1e-9;
+            const double alpha = 1.0 - std::exp(-dt / EWMA_SECONDS);
+            const double ewma = mEwma.load(std::memory_order_relaxed);
+            mEwma.store(ewma + alpha * (1.0 / dt - ewma), std::memory_order_relaxed);
+        }
+        if (mFirstNs.load(std::memory_order_relaxed) < 0) mFirstNs.store(ns, std::memory_order_relaxed);
+        mLastNs.store(ns, std::memory_order_release);
+        return last;
+    }
+
+    /** @brief Rate returns the events per second over the last `seconds` whole seconds (at most WINDOW_SECONDS).
+     *  Before the meter has run that long, the window is shortened to the time it has been running.
+     */
+    double rate(const int seconds, const int64_t now_ns) const
+    {
+        if (resetPending()) return 0.0;
+        const int64_t first_ns = mFirstNs.load(std::memory_order_acquire);
+        if (first_ns < 0) return 0.0;
+        const int64_t current = now_ns / 1000000000LL;
+        const int64_t first = first_ns / 1000000000LL;
+        int64_t window = seconds < WINDOW_SECONDS ? seconds : WINDOW_SECONDS;
+        if (current - first < window) window = current - first;
+        if (window <= 0) return 0.0;
+
+        uint64_t count = 0;
+        for (int64_t s = current - window; s < current; s++)
+        {
+            const uint64_t word = mBuckets[s % BUCKETS].load(std::memory_order_relaxed);
+            if ((word >> 32) == (uint32_t)s) count += word & COUNT_MASK;
+        }
+        return (double)count / window;
+    }
+
+    /** @brief Ewma returns the smoothed rate, decayed for the time since the last event
+     */
+    double ewma(const int64_t now_ns) const
+    {
+        if (resetPending()) return 0.0;
+        const int64_t last = mLastNs.load(std::memory_order_acquire);
+        if (last < 0) return 0.0;
+        const double ewma = mEwma.load(std::memory_order_relaxed);
+        const double idle = (now_ns - last) * 1e-9;
+        return idle > 0 ? ewma * std::exp(-idle / EWMA_SECONDS) : ewma;
+    }
+
+    uint64_t total() const
+    {
+        return resetPending() ? 0 : mTotal.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    static const int BUCKETS = WINDOW_SECONDS + 1;    // the extra bucket is the current second
+    static const uint64_t COUNT_MASK = 0xffffffffULL;
+
+    /** @brief Clear empties the meter, on the writer's thread (or in the constructor)
+     */
+    void clear()
+    {
+        for (int b = 0; b < BUCKETS; b++) mBuckets[b].store(0, std::memory_order_relaxed);
+        mTotal.store(0, std::memory_order_relaxed);
+        mEwma.store(0.0, std::memory_order_relaxed);
+        mFirstNs.store(-1, std::memory_order_relaxed);
+        mLastNs.store(-1, std::memory_order_release);
+    }
+
+    bool resetPending() const
+    {
+        return mResetRequests.load(std::memory_order_acquire) != mResetsApplied.load(std::memory_order_acquire);
+    }
+
+    std::atomic<uint64_t> mBuckets[BUCKETS];
+    std::atomic<uint64_t> mTotal;
+    std::atomic<double> mEwma;
+    std::atomic<int64_t> mLastNs;
+    std::atomic<int64_t> mFirstNs;
+    std::atomic<uint32_t> mResetRequests;    // bumped by reset() on any thread
+    std::atomic<uint32_t> mResetsApplied;    // caught up by the writer
+};
+
+/** @brief Throughput of a capture/detection pipeline: frames captured from the source, submitted to the detector and
+ *  processed by it, plus frames dropped anywhere along the way.
+ *  Each stage records from its own thread, and only from that one, so its total and rates live on its RateMeter;
+ *  reading and reset() are safe from any thread. Drops come from several threads (capture, detector callbacks) at
+ *  once and are counted on a ShardedCounter.
+ */
+class ThroughputStats
+{
+public:
+
+    ThroughputStats() {}
+
+    // Each returns the time of the stage's previous frame, see RateMeter::record
+    int64_t captured(const int64_t ns = steadyNanos()) { return mCaptured.record(ns); }
+    int64_t submitted(const int64_t ns = steadyNanos()) { return mSubmitted.record(ns); }
+    int64_t processed(const int64_t ns = steadyNanos()) { return mProcessed.record(ns); }
+    void dropped(const uint64_t count = 1) { mDropped.add(count); }
+
+    const RateMeter &capturedMeter() const { return mCaptured; }
+    const RateMeter &submittedMeter() const { return mSubmitted; }
+    const RateMeter &processedMeter() const { return mProcessed; }
+    uint64_t capturedCount() const { return mCaptured.total(); }
+    uint64_t submittedCount() const { return mSubmitted.total(); }
+    uint64_t processedCount() const { return mProcessed.total(); }
+    uint64_t droppedCount() const { return mDropped.value(); }
+
+    /** @brief Reset restarts every stage from zero, without waiting for (or racing) the threads recording them.
+     *  Every number reads zero as soon as reset() returns: a stage's total and rates together, since they live on one
+     *  RateMeter that reads zero until its writer has cleared it, and the drop count, which is cleared in place.
+     *  Drops counted while reset() runs may land on either side of it.
+     */
+    void reset()
+    {
+        mCaptured.reset();
+        mSubmitted.reset();
+        mProcessed.reset();
+        mDropped.reset();
+    }
+
+    /** @brief Report renders one line per stage: total, rates over 1s/10s/60s and the EWMA, in frames per second
+     */
+    std::string report() const
+    {
+        const int64_t now = steadyNanos();
+        char line[128];
+        std::string out;
+        const RateMeter *meters[] = { &mCaptured, &mSubmitted, &mProcessed };
+        const uint64_t totals[] = { capturedCount(), submittedCount(), processedCount() };
+        const char *names[] = { "captured", "submitted", "processed" };
+        for (int m = 0; m < 3; m++)
+        {
+            const RateMeter &meter = *meters[m];
+            if (totals[m] == 0) continue;
+            snprintf(line, sizeof(line), "%-10s total=%-9llu 1s=%6.2f 10s=%6.2f 60s=%6.2f ewma=%6.2f fps\n", names[m],
+                     (unsigned long long)totals[m], meter.rate(1, now), meter.rate(10, now), meter.rate(60, now),
+                     meter.ewma(now));
+            out += line;
+        }
+        snprintf(line, sizeof(line), "%-10s total=%llu\n", "dropped", (unsigned long long)droppedCount());
+        return out + line;
+    }
+
+private:
+
+    RateMeter mCaptured;
+    RateMeter mSubmitted;
+    RateMeter mProcessed;
+    ShardedCounter mDropped;
+};
@@ -0,0 +1,422 @@
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "FrameClock.hpp"
+
+/** @brief Records timed spans of the processing pipeline into per-thread ring buffers and writes them as Chrome
+ *  trace-event JSON, which chrome://tracing and https://ui.perfetto.dev open as a timeline.
+ *  Each thread appends to its own buffer without locking; once a buffer holds EVENTS_PER_THREAD events the oldest
+ *  ones are overwritten, so a trace always covers the most recent activity. When a thread exits its buffer goes back
+ *  to the recorder, still dumpable, until a new thread takes it over: memory follows the most threads alive at once,
+ *  not every thread ever started. While disabled, a span costs one relaxed atomic load and a branch. Defining
+ *  DISABLE_TRACING compiles the macros out entirely.
+ */
+class TraceRecorder
+{
+public:
+
+    static const size_t EVENTS_PER_THREAD = 1 << 16;
+
+    static TraceRecorder &instance()
+    {
+        static TraceRecorder recorder;
+        return recorder;
+    }
+
+    static bool enabled()
+    {
+        return enabledFlag().load(std::memory_order_relaxed);
+    }
+
+    static void enable(const bool on)
+    {
+        enabledFlag().store(on, std::memory_order_relaxed);
+    }
+
+    /** @brief NameThread labels the calling thread in the trace. Cheap enough to call whether or not tracing is on.
+     * @param name -- String literal, or any string that outlives the recorder
+     */
+    static void nameThread(const char *name)
+    {
+        threadName() = name;
+    }
+
+    /** @brief Complete records a span of the calling thread
+     * @param name  -- String literal
+     * @param frame -- Sequence number of the frame the span works on, -1 if none
+     */
+    void complete(const char *name, const int64_t start_ns, const int64_t end_ns, const int64_t frame = -1)
+    {
+        const Event e = { name, start_ns, end_ns - start_ns, frame, 'X' };
+        buffer().push(e);
+    }
+
+    /** @brief FrameSpan records a span that follows a frame across threads (e.g. from capture to its result), see
+     *  TRACE_FRAME_SPAN. Spans of one frame share a row in the viewer, overlapping frames get rows of their own.
+     */
+    void frameSpan(const char *name, const int64_t frame, const int64_t start_ns, const int64_t end_ns)
+    {
+        const Event e = { name, start_ns, end_ns - start_ns, frame, 'b' };
+        buffer().push(e);
+    }
+
+    /** @brief Dump writes every buffered event to path as trace-event JSON. Threads may keep recording meanwhile:
+     *  events they overwrite during the dump are left out.
+     * @return false if the file could not be written
+     */
+    bool dump(const std::string &path)
+    {
+        FILE *out = fopen(path.c_str(), "w");
+        if (!out) return false;
+#ifdef _WIN32
+        const int pid = _getpid();
+#else
+        const int pid = (int)getpid();
+#endif
+
+        // The owner of each buffer and its range of events, as of now: a buffer handed to a new thread meanwhile
+        // keeps being dumped under its previous owner, up to the events that owner wrote
+        struct Snapshot
+        {
+            ThreadBuffer *buffer;
+            unsigned int tid;
+            const char *name;
+            uint64_t begin;
+            uint64_t end;
+        };
+        std::vector<Snapshot> snapshots;
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            for (const std::unique_ptr<ThreadBuffer> &b : mBuffers)
+            {
+                const uint64_t end = b->written.load(std::memory_order_acquire);
+                const uint64_t oldest = end > b->slots.size() ? end - b->slots.size() : 0;
+                const Snapshot snapshot = { b.get(), b->tid, b->name, oldest > b->first ? oldest : b->first, end };
+                snapshots.push_back(snapshot);
+            }
+        }
+
+        fprintf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+        bool first = true;
+        for (const Snapshot &s : snapshots)
+        {
+            fprintf(out, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                    first ? "" : ",\n", pid, s.tid, s.name);
+            first = false;
+
+            // Copied first and written afterwards, so the owner has less time to lap the oldest events
+            std::vector<Event> events;
+            events.reserve((size_t)(s.end - s.begin));
+            Event e;
+            for (uint64_t i = s.begin; i < s.end; i++)
+            {
+                if (s.buffer->read(i, e)) events.push_back(e);
+            }
+            for (const Event &event : events) writeEvent(out, event, pid, s.tid);
+        }
+        fprintf(out, "\n]}\n");
+        const bool ok = !ferror(out);
+        return fclose(out) == 0 && ok;
+    }
+
+private:
+
+    struct Event
+    {
+        const char *name;
+        int64_t startNs;
+        int64_t durationNs;
+        int64_t frame;
+        char phase;        // 'X' complete span on its thread, 'b' frame span (written as a b/e pair)
+    };
+
+    /** @brief Slot holds one event under a sequence lock, so dump() can read it while the owner overwrites it.
+     *  Every field is a relaxed atomic; the stamp tells which event the fields belong to, and whether they are
+     *  being written.
+     */
+    struct Slot
+    {
+        Slot() : stamp(0), name(nullptr), startNs(0), durationNs(0), frame(0), phase(0) {}
+
+        std::atomic<uint64_t> stamp;    // 2 * index + 1 while event `index` is being written, 2 * index + 2 after
+        std::atomic<const char *> name;
+        std::atomic<int64_t> startNs;
+        std::atomic<int64_t> durationNs;
+        std::atomic<int64_t> frame;
+        std::atomic<char> phase;
+    };
+
+    /** @brief Events of one thread. Only the owning thread writes; dump() reads up to the published count.
+     *  Who owns it (tid, name, first) only changes under the recorder's mutex, when a new thread takes it over.
+     */
+    struct ThreadBuffer
+    {
+        ThreadBuffer() : slots(EVENTS_PER_THREAD), written(0), tid(0), name(nullptr), first(0) {}
+
+        void push(const Event &e)
+        {
+            const uint64_t n = written.load(std::memory_order_relaxed);
+            Slot &slot = slots[(size_t)(n % slots.size())];
+            slot.stamp.store(2 * n + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);    // the busy stamp lands before any field
+            slot.name.store(e.name, std::memory_order_relaxed);
+            slot.startNs.store(e.startNs, std::memory_order_relaxed);
+            slot.durationNs.store(e.durationNs, std::memory_order_relaxed);
+            slot.frame.store(e.frame, std::memory_order_relaxed);
+            slot.phase.store(e.phase, std::memory_order_relaxed);
+            slot.stamp.store(2 * n + 2, std::memory_order_release);
+            written.store(n + 1, std::memory_order_release);
+        }
+
+        /** @brief Read copies event `index` into e, unless it is being overwritten or already has been
+         */
+        bool read(const uint64_t index, Event &e) const
+        {
+            const Slot &slot = slots[(size_t)(index % slots.size())];
+            const uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+            if (stamp != 2 * index + 2) return false;
+            e.name = slot.name.load(std::memory_order_relaxed);
+            e.startNs = slot.startNs.load(std::memory_order_relaxed);
+            e.durationNs = slot.durationNs.load(std::memory_order_relaxed);
+            e.frame = slot.frame.load(std::memory_order_relaxed);
+            e.phase = slot.phase.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);    // the fields are read before the stamp again
+            return slot.stamp.load(std::memory_order_relaxed) == stamp;
+        }
+
+        std::vector<Slot> slots;
+        std::atomic<uint64_t> written;
+        unsigned int tid;
+        const char *name;
+        uint64_t first;     // count written when the current owner took the buffer, older events are not its own
+    };
+
+    /** @brief Lease gives the calling thread's buffer back to the recorder when the thread exits
+     */
+    struct Lease
+    {
+        Lease() : buffer(nullptr) {}
+
+        ~Lease()
+        {
+            if (buffer) TraceRecorder::instance().release(*buffer);
+        }
+
+        ThreadBuffer *buffer;
+    };
+
+    TraceRecorder() : mThreads(0) {}
+
+    static std::atomic<bool> &enabledFlag()
+    {
+        static std::atomic<bool> flag(false);
+        return flag;
+    }
+
+    static const char *&threadName()
+    {
+        thread_local const char *name = nullptr;
+        return name;
+    }
+
+    /** @brief Buffer returns the calling thread's buffer, taken on its first event: the buffer of an exited thread
+     *  if there is one, a new buffer otherwise.
+     */
+    ThreadBuffer &buffer()
+    {
+        thread_local Lease lease;
+        if (!lease.buffer)
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            if (mFree.empty())
+            {
+                mBuffers.push_back(std::unique_ptr<ThreadBuffer>(new ThreadBuffer()));
+                mFree.push_back(mBuffers.back().get());
+            }
+            ThreadBuffer *b = mFree.back();
+            mFree.pop_back();
+            b->tid = ++mThreads;
+            b->name = threadName() ? threadName() : "thread";
+            b->first = b->written.load(std::memory_order_relaxed);
+            lease.buffer = b;
+        }
+        return *lease.buffer;
+    }
+
+    void release(ThreadBuffer &buffer)
+    {
+        std::lock_guard<std::mutex> lg(mMutex);
+        mFree.push_back(&buffer);
+    }
+
+    static void writeEvent(FILE *out, const Event &e, const int pid, const unsigned int tid)
+    {
+        const double ts = e.startNs / 1e3;    // microseconds
+        if (e.phase == 'b')
+        {
+            fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"b\",\"id\":%lld,\"pid\":%d,\"tid\":%u,\"ts\":%.3f}"
+                    ",\n{\"name\":\"%s\",\"cat\":\"frame\",\"ph\":\"e\",\"id\":%lld,\"pid\":%d,\"tid\":%u,\"ts\":%.3f}",
+                    e.name, (long long)e.frame, pid, tid, ts, e.name, (long long)e.frame, pid, tid, ts + e.durationNs / 1e3);
+        }
+        else if (e.frame >= 0)
+        {
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%lld}}",
+                    e.name, pid, tid, ts, e.durationNs / 1e3, (long long)e.frame);
+        }
+        else
+        {
+            fprintf(out, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    e.name, pid, tid, ts, e.durationNs / 1e3);
+        }
+    }
+
+    std::mutex mMutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
+    std::vector<ThreadBuffer *> mFree;    // buffers of exited threads, their events are dumped until reused
+    unsigned int mThreads;
+};
+
+/** @brief Records a span from its construction to the end of the enclosing scope, see TRACE_SCOPE
+ */
+class TraceScope
+{
+public:
+
+    explicit TraceScope(const char *name, const int64_t frame = -1)
+        : mName(name), mFrame(frame), mStart(TraceRecorder::enabled() ? steadyNanos() : -1)
+    {
+    }
+
+    ~TraceScope()
+    {
+        if (mStart >= 0) TraceRecorder::instance().complete(mName, mStart, steadyNanos(), mFrame);
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+
+    const char *mName;
+    const int64_t mFrame;
+    const int64_t mStart;
+};
+
+/** @brief Enables tracing for its lifetime and writes the trace to a file when it ends, and whenever the process
+ *  receives SIGUSR1 (Ctrl+Break on Windows). The signal handler only sets a flag, a watcher thread does the writing.
+ */
+class TraceSession
+{
+public:
+
+    explicit TraceSession(const std::string &path) : mPath(path), mStop(false)
+    {
+        TraceRecorder::enable(true);
+#if defined(SIGUSR1)
+        std::signal(SIGUSR1, &TraceSession::onSignal);
+#elif defined(SIGBREAK)
+        std::signal(SIGBREAK, &TraceSession::onSignal);
+#endif
+        mWatcher = std::thread(&TraceSession::watch, this);
+    }
+
+    TraceSession(const TraceSession&) = delete;
+    TraceSession& operator=(const TraceSession&) = delete;
+
+    ~TraceSession()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mMutex);
+            mStop = true;
+        }
+        mWakeUp.notify_one();
+        mWatcher.join();
+        TraceRecorder::enable(false);
+        write();
+    }
+
+private:
+
+    static volatile std::sig_atomic_t &dumpRequested()
+    {
+        static volatile std::sig_atomic_t requested = 0;
+        return requested;
+    }
+
+    static void onSignal(int sig)
+    {
+        dumpRequested() = 1;
+        std::signal(sig, &TraceSession::onSignal);    // some platforms reset the handler once it runs
+    }
+
+    void watch()
+    {
+        std::unique_lock<std::mutex> lk(mMutex);
+        while (!mWakeUp.wait_for(lk, std::chrono::milliseconds(100), [this] { return mStop; }))
+        {
+            if (!dumpRequested()) continue;
+            dumpRequested() = 0;
+            lk.unlock();
+            write();
+            lk.lock();
+        }
+    }
+
+    void write() const
+    {
+        if (TraceRecorder::instance().dump(mPath))
+        {
+            std::cerr << "Trace written to " << mPath << std::endl;
+        }
+        else
+        {
+            std::cerr << "Unable to write the trace to " << mPath << std::endl;
+        }
+    }
+
+    const std::string mPath;
+    bool mStop;
+    std::mutex mMutex;
+    std::condition_variable mWakeUp;
+    std::thread mWatcher;
+};
+
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+#ifdef DISABLE_TRACING
+#define TRACE_SCOPE(name) ((void)0)
+#define TRACE_SCOPE_FRAME(name, frame) ((void)0)
+#define TRACE_FRAME_SPAN(name, frame, start_ns, end_ns) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#else
+/** @brief TRACE_SCOPE(name) times the rest of the enclosing scope as a span called name (a string literal)
+ */
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name)
+/** @brief TRACE_SCOPE_FRAME(name, frame) also tags the span with the sequence number of the frame it works on
+ */
+#define TRACE_SCOPE_FRAME(name, frame) TraceScope TRACE_CONCAT(traceScope, __LINE__)(name, (int64_t)(frame))
+/** @brief TRACE_FRAME_SPAN(name, frame, start_ns, end_ns) records a span measured by the caller, on the frame's row
+ */
+#define TRACE_FRAME_SPAN(name, frame, start_ns, end_ns) \
+    do { if (TraceRecorder::enabled()) TraceRecorder::instance().frameSpan(name, (int64_t)(frame), start_ns, end_ns); } while (0)
+#define TRACE_THREAD_NAME(name) TraceRecorder::nameThread(name)
+#endif
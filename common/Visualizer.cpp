@@ -1,82 +1,32 @@
 #include "Visualizer.h"
-#include <boost/format.hpp>
+#include <cstdio>
 #include "affdex_small_logo.h"
 #include <algorithm>
+#include <cstdint>
+#include <cstring>
 
-Visualizer::Visualizer():
-  GREEN_COLOR_CLASSIFIERS({
-    "joy"
-  }),
-  RED_COLOR_CLASSIFIERS({
-    "anger", "disgust", "sadness", "fear", "contempt"
-  })
+#include "AlphaBlend.hpp"
+
+const char *const Visualizer::ATLAS_GLYPHS = "0123456789.-+ ";
+
+Visualizer::Visualizer()
 {
     logo_resized = false;
     logo = cv::imdecode(cv::InputArray(small_logo), CV_LOAD_IMAGE_UNCHANGED);
 
-    EXPRESSIONS = {
-        "smile", "innerBrowRaise", "browRaise", "browFurrow", "noseWrinkle",
-        "upperLipRaise", "lipCornerDepressor", "chinRaise", "lipPucker", "lipPress",
-        "lipSuck", "mouthOpen", "smirk", "eyeClosure", "attention", "eyeWiden", "cheekRaise",
-        "lidTighten", "dimpler", "lipStretch", "jawDrop"
-    };
-
-    EMOTIONS = {
-        "joy", "fear", "disgust", "sadness", "anger",
-        "surprise", "contempt", "valence", "engagement"
-    };
-
-    HEAD_ANGLES = { "pitch", "yaw", "roll" };
-
-
-    EMOJIS = std::vector<std::string> {
-        "relaxed", "smiley", "laughing",
-            "kissing", "disappointed",
-            "rage", "smirk", "wink",
-            "stuckOutTongueWinkingEye", "stuckOutTongue",
-            "flushed", "scream"
-    };
-
-    GENDER_MAP = std::map<affdex::Gender, std::string> {
-        { affdex::Gender::Male, "male" },
-        { affdex::Gender::Female, "female" },
-        { affdex::Gender::Unknown, "unknown" },
-
-    };
-
-    GLASSES_MAP = std::map<affdex::Glasses, std::string> {
-        { affdex::Glasses::Yes, "yes" },
-        { affdex::Glasses::No, "no" }
-    };
-
-    AGE_MAP = std::map<affdex::Age, std::string> {
-        { affdex::Age::AGE_UNKNOWN, "unknown"},
-        { affdex::Age::AGE_UNDER_18, "under 18" },
-        { affdex::Age::AGE_18_24, "18-24" },
-        { affdex::Age::AGE_25_34, "25-34" },
-        { affdex::Age::AGE_35_44, "35-44" },
-        { affdex::Age::AGE_45_54, "45-54" },
-        { affdex::Age::AGE_55_64, "55-64" },
-        { affdex::Age::AGE_65_PLUS, "65 plus" }
-    };
-
-    ETHNICITY_MAP = std::map<affdex::Ethnicity, std::string> {
-        { affdex::Ethnicity::UNKNOWN, "unknown"},
-        { affdex::Ethnicity::CAUCASIAN, "caucasian" },
-        { affdex::Ethnicity::BLACK_AFRICAN, "black african" },
-        { affdex::Ethnicity::SOUTH_ASIAN, "south asian" },
-        { affdex::Ethnicity::EAST_ASIAN, "east asian" },
-        { affdex::Ethnicity::HISPANIC, "hispanic" }
-    };
+    for (const char *c = ATLAS_GLYPHS; *c; c++)
+    {
+        glyph_atlas[(uchar)*c] = rasterizeText(std::string(1, *c), false);
+    }
 }
 
-void Visualizer::drawFaceMetrics(affdex::Face face, std::vector<cv::Point2f> bounding_box)
+void Visualizer::drawFaceMetrics(const affdex::Face &face, const std::vector<cv::Point2f> &bounding_box)
 {
     cv::Scalar white_color = cv::Scalar(255, 255, 255);
 
     //Draw Right side metrics
     int padding = bounding_box[0].y; //Top left Y
-    drawValues((float *)&face.expressions, EXPRESSIONS,
+    drawValues(&face.expressions, metrics::EXPRESSIONS,
                bounding_box[2].x + spacing, padding, white_color, false);
 
     padding = bounding_box[2].y;  //Top left Y
@@ -88,19 +38,18 @@ void Visualizer::drawFaceMetrics(affdex::Face face, std::vector<cv::Point2f> bou
     drawAppearance(face.appearance, bounding_box[0].x - spacing, padding);
 
     //Draw Left side metrics
-    drawValues((float *)&face.emotions, EMOTIONS,
+    drawValues(&face.emotions, metrics::EMOTIONS,
                bounding_box[0].x - spacing, padding, white_color, true);
 
 }
 
-void Visualizer::drawValues(const float * first, const std::vector<std::string> names,
+void Visualizer::drawValues(const void * group, const metrics::MetricRange &range,
                             const int x, int &padding, const cv::Scalar clr, const bool align_right)
 {
 
-    for (std::string name : names)
+    for (const metrics::Metric &metric : range)
     {
-        drawClassifierOutput(name, (*first), cv::Point(x, padding += spacing), align_right);
-        first++;
+        drawClassifierOutput(metric, metrics::value(group, metric), cv::Point(x, padding += spacing), align_right);
     }
 }
 
@@ -114,9 +63,17 @@ void Visualizer::updateImage(cv::Mat output_img)
       double logo_height = ((double)logo_width) * ((double)logo.size().height / logo.size().width);
       cv::resize(logo, logo, cv::Size(logo_width, logo_height));
       logo_resized = true;
+      logo_overlay.prepare(logo);
   }
   cv::Mat roi = img(cv::Rect(img.cols - logo.cols - 10, 10, logo.cols, logo.rows));
-  overlayImage(logo, roi, cv::Point(0, 0));
+  if (img.type() == CV_8UC3)
+  {
+      logo_overlay.composite(roi);
+  }
+  else
+  {
+      overlayImage(logo, roi, cv::Point(0, 0));
+  }
 }
 
 void Visualizer::drawPoints(affdex::VecFeaturePoint points)
@@ -144,7 +101,7 @@ void Visualizer::drawBoundingBox(cv::Point2f top_left, cv::Point2f bottom_right,
  * @param align_right -- Whether to right or left justify the text
  * @param color         -- Color
  */
-void Visualizer::drawText(const std::string& name, const std::string& value,
+void Visualizer::drawText(const char *name, const char *value,
                           const cv::Point2f loc, bool align_right, cv::Scalar color)
 {
     const int block_width = 8;
@@ -153,27 +110,42 @@ void Visualizer::drawText(const std::string& name, const std::string& value,
     const int max_blocks = 100/block_size;
 
     cv::Point2f display_loc = loc;
-    const std::string label = name+": ";
+    const TextSprite &label = cachedSprite(text_sprites, label_text.assign(name).append(": "), false);
 
     if( align_right )
     {
         display_loc.x -= (margin+block_width) * max_blocks;
-        int baseline=0;
-        cv::Size txtSize = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5f, 5,&baseline);
-        display_loc.x -= txtSize.width;
+        display_loc.x -= label.measured_width;
+    }
+    cv::Point origin = display_loc;
+    blitSprite(label, origin, color);
+    origin.x += label.advance;
+
+    // Numbers change every frame, they are assembled from the glyph atlas instead of getting their own sprite
+    if (value[strspn(value, ATLAS_GLYPHS)] == '\0')
+    {
+        for (const char *c = value; *c; c++)
+        {
+            const TextSprite &glyph = glyph_atlas[(uchar)*c];
+            blitSprite(glyph, origin, color);
+            origin.x += glyph.advance;
+        }
+    }
+    else
+    {
+        blitSprite(cachedSprite(text_sprites, label_text.assign(value), false), origin, color);
     }
-    cv::putText(img, label+value, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, color, 1);
 }
 
 
 
 /** @brief DrawClassifierOutput handles choosing between equalizer or text as well as defining the colors
- * @param name        -- Name of the classifier
+ * @param metric      -- The classifier, its tint picks the color
  * @param value       -- Value we are trying to display
  * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
  * @param align_right -- Whether to right or left justify the text
  */
-void Visualizer::drawClassifierOutput(const std::string& classifier,
+void Visualizer::drawClassifierOutput(const metrics::Metric& metric,
                                       const float value, const cv::Point2f& loc, bool align_right)
 {
 
@@ -182,28 +154,27 @@ void Visualizer::drawClassifierOutput(const std::string& classifier,
 
     // Determine the display color
     cv::Scalar color = cv::Scalar(255, 255, 255);
-    if( classifier == "valence")
+    float equalizer_magnitude = value;
+    switch( metric.tint )
     {
+    case metrics::Tint::VALENCE:
         color = valence_color_generator( value );
-    }
-    else if( RED_COLOR_CLASSIFIERS.count(classifier) )
-    {
+        equalizer_magnitude = std::fabs(value);
+        break;
+    case metrics::Tint::RED:
         color = cv::Scalar(0, 0, 255);
-    }
-    else if( GREEN_COLOR_CLASSIFIERS.count(classifier) )
-    {
+        break;
+    case metrics::Tint::GREEN:
         color = cv::Scalar(0, 255, 0);
+        break;
+    case metrics::Tint::WHITE:
+        break;
     }
 
-    float equalizer_magnitude = value;
-    if( classifier == "valence" )
-    {
-        equalizer_magnitude = std::fabs(value);
-    }
-    drawEqualizer(classifier, equalizer_magnitude, loc, align_right, color );
+    drawEqualizer(metric.name, equalizer_magnitude, loc, align_right, color );
 }
 
-void Visualizer::drawEqualizer(const std::string& name, const float value, const cv::Point2f& loc,
+void Visualizer::drawEqualizer(const char *name, const float value, const cv::Point2f& loc,
                                bool align_right, cv::Scalar color)
 {
     const int block_width = 8;
@@ -215,7 +186,6 @@ void Visualizer::drawEqualizer(const std::string& name, const float value, const
     int i = loc.x, j = loc.y - 10;
 
     cv::Point2f display_loc = loc;
-    const std::string label = align_right? name+": " : " :"+name;
 
     for (int x = 0 ; x < (100/block_size) ; x++)
     {
@@ -226,52 +196,125 @@ void Visualizer::drawEqualizer(const std::string& name, const float value, const
         const int width = (std::min)(float(block_width), float(img.size().width-ii));
         const int height = (std::min)(float(block_height), float(img.size().height-jj));
         if (height < 0 || width < 0) continue;
-        cv::Mat roi = img(cv::Rect(ii, jj, width, height));
         if (x >= blocks)
         {
             alpha = 0.3;
             scalar_clr = cv::Scalar(186, 186, 186);
         }
-        cv::Mat color(roi.size(), CV_8UC3, scalar_clr);
-        cv::addWeighted(color, alpha, roi, 1.0 - alpha , 0.0, roi);
+        // Blended straight into the frame, before the label is drawn over the bar
+        if (img.type() == CV_8UC3)
+        {
+            blend::blendRect(img, cv::Rect(ii, jj, width, height), scalar_clr, cvRound(alpha * 256));
+        }
 
         i += align_right? -(margin+block_width):(margin+block_width);
     }
     display_loc.x += align_right? -(margin+block_width) * max_blocks : (margin+block_width) * max_blocks;
+
+    if (align_right) label_text.assign(name).append(": ");
+    else label_text.assign(" :").append(name);
+    const TextSprite &label = cachedSprite(equalizer_labels, label_text, true);
     if( align_right )
     {
-        int baseline=0;
-        cv::Size txtSize = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5f, 5,&baseline);
-        display_loc.x -= txtSize.width;
+        display_loc.x -= label.measured_width;
     }
-    cv::putText(img, label, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, cv::Scalar(50,50,50), 5);
-    cv::putText(img, label, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, cv::Scalar(255, 255, 255), 1);
+    blitSprite(label, display_loc, cv::Scalar(255, 255, 255));
 
 }
 
+Visualizer::TextSprite Visualizer::rasterizeText(const std::string &text, const bool shadow)
+{
+    const int font = cv::FONT_HERSHEY_SIMPLEX;
+    const double scale = 0.5;
+    const int pad = 4;
+
+    TextSprite sprite;
+    int baseline = 0;
+    const cv::Size size = cv::getTextSize(text, font, scale, 5, &baseline);
+    sprite.measured_width = size.width;
+    sprite.advance = cv::getTextSize(text, font, scale, 0, &baseline).width;
+
+    // Layer 1 is the thick dark shadow, layer 2 the foreground drawn over it
+    cv::Mat mask(size.height + baseline + 2 * pad, size.width + 2 * pad, CV_8UC1, cv::Scalar(0));
+    const cv::Point origin(pad, pad + size.height);
+    if (shadow) cv::putText(mask, text, origin, font, scale, cv::Scalar(1), 5);
+    cv::putText(mask, text, origin, font, scale, cv::Scalar(2), 1);
+
+    for (int y = 0; y < mask.rows; y++)
+    {
+        const uchar *row = mask.ptr<uchar>(y);
+        for (int x = 0; x < mask.cols; )
+        {
+            if (row[x] == 0) { x++; continue; }
+            TextRun run;
+            run.dx = (short)(x - origin.x);
+            run.dy = (short)(y - origin.y);
+            run.layer = row[x];
+            const int start = x;
+            while (x < mask.cols && row[x] == run.layer) x++;
+            run.length = (short)(x - start);
+            sprite.runs.push_back(run);
+        }
+    }
+    return sprite;
+}
+
+const Visualizer::TextSprite &Visualizer::cachedSprite(std::map<std::string, TextSprite> &cache,
+                                                       const std::string &text, const bool shadow)
+{
+    std::map<std::string, TextSprite>::const_iterator it = cache.find(text);
+    if (it == cache.end())
+    {
+        it = cache.insert(std::make_pair(text, rasterizeText(text, shadow))).first;
+    }
+    return it->second;
+}
+
+void Visualizer::blitSprite(const TextSprite &sprite, const cv::Point &origin, const cv::Scalar &color)
+{
+    const uchar shadow_bgr[3] = { 50, 50, 50 };
+    const uchar color_bgr[3] = { cv::saturate_cast<uchar>(color[0]), cv::saturate_cast<uchar>(color[1]),
+                                 cv::saturate_cast<uchar>(color[2]) };
+    const int cn = img.channels();
+
+    for (const TextRun &run : sprite.runs)
+    {
+        const int y = origin.y + run.dy;
+        if (y < 0 || y >= img.rows) continue;
+        const int x0 = (std::max)(origin.x + run.dx, 0);
+        const int x1 = (std::min)(origin.x + run.dx + run.length, img.cols);
+        const uchar *bgr = run.layer == 1 ? shadow_bgr : color_bgr;
+        uchar *dst = img.ptr<uchar>(y) + x0 * cn;
+        for (int x = x0; x < x1; x++, dst += cn)
+        {
+            for (int c = 0; c < (std::min)(cn, 3); c++) dst[c] = bgr[c];
+        }
+    }
+}
+
 void Visualizer::drawHeadOrientation(affdex::Orientation headAngles, const int x, int &padding,
                                      bool align_right, cv::Scalar color)
 {
-    std::string valueStr = boost::str(boost::format("%3.1f") % headAngles.pitch);
-    drawText("pitch", valueStr, cv::Point(x, padding += spacing), align_right, color );
-    valueStr = boost::str(boost::format("%3.1f") % headAngles.yaw);
-    drawText("yaw", valueStr, cv::Point(x, padding += spacing), align_right, color );
-    valueStr = boost::str(boost::format("%3.1f") % headAngles.roll);
-    drawText("roll", valueStr, cv::Point(x, padding += spacing), align_right, color );
+    for (const metrics::Metric &metric : metrics::HEAD_ANGLES)
+    {
+        char valueStr[32];
+        snprintf(valueStr, sizeof(valueStr), "%3.1f", metrics::value(&headAngles, metric));
+        drawText(metric.name, valueStr, cv::Point(x, padding += spacing), align_right, color );
+    }
 }
 
 void Visualizer::drawAppearance(affdex::Appearance appearance, const int x, int &padding,
                               bool align_right, cv::Scalar color)
 {
-    drawText("gender", GENDER_MAP[appearance.gender], cv::Point(x, padding += spacing), align_right, color );
-    drawText("age", AGE_MAP[appearance.age], cv::Point(x, padding += spacing), align_right, color );
-    drawText("ethnicity", ETHNICITY_MAP[appearance.ethnicity], cv::Point(x, padding += spacing), align_right, color );
+    drawText("gender", metrics::name(metrics::GENDER_NAMES, appearance.gender), cv::Point(x, padding += spacing), align_right, color );
+    drawText("age", metrics::name(metrics::AGE_NAMES, appearance.age), cv::Point(x, padding += spacing), align_right, color );
+    drawText("ethnicity", metrics::name(metrics::ETHNICITY_NAMES, appearance.ethnicity), cv::Point(x, padding += spacing), align_right, color );
 
 }
 
-void Visualizer::showImage()
+void Visualizer::showImage(const cv::Mat &image)
 {
-    cv::imshow("analyze video", img);
+    cv::imshow("analyze video", image);
     cv::waitKey(5);
 }
 
@@ -1,8 +1,14 @@
+#pragma once
+
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <Frame.h>
 #include <Face.h>
-#include <set>
+#include <cstdint>
+#include <map>
+
+#include "MetricSchema.hpp"
+#include "AlphaBlend.hpp"
 
 /** @brief Plot the face metrics using opencv highgui
  */
@@ -56,11 +62,13 @@ public:
   * @param face         -- The affdex::Face object to display
   * @param bounding_box -- The bounding box coordinates
   */
-  void drawFaceMetrics(affdex::Face face, std::vector<cv::Point2f> bounding_box);
+  void drawFaceMetrics(const affdex::Face &face, const std::vector<cv::Point2f> &bounding_box);
 
-  /** @brief ShowImage displays image on screen
+  /** @brief ShowImage displays an image drawn by the visualizer on screen and processes window events.
+  * Like all of HighGUI, call it from the main thread only.
+  * @param image -- The image to display
   */
-  void showImage();
+  static void showImage(const cv::Mat &image);
 
   /**
    * Overlay an image with an Alpha (foreground) channel over background
@@ -71,62 +79,92 @@ public:
    */
   void overlayImage(const cv::Mat &foreground, cv::Mat &background, cv::Point2i location);
 
+  /** @brief DrawEqualizer displays an equalizer on screen either right or left justified at the anchor location (loc).
+  * Each bar is blended into the image before the label is drawn over it.
+  * @param name        -- Name of the classifier
+  * @param value       -- Value we are trying to display
+  * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
+  * @param align_right -- Whether to right or left justify the text
+  * @param color       -- Color
+  */
+  void drawEqualizer(const char *name, const float value, const cv::Point2f& loc,
+                     bool align_right, cv::Scalar color);
+
+  /** @brief DrawText displays an text on screen either right or left justified at the anchor location (loc).
+  * The label comes from the sprite cache, numeric values from the glyph atlas.
+  * @param name        -- Name of the classifier
+  * @param value       -- Value we are trying to display
+  * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
+  * @param align_right -- Whether to right or left justify the text
+  * @param color       -- Color
+  */
+  void drawText(const char *name, const char *value,
+                const cv::Point2f loc, bool align_right=false, cv::Scalar color=cv::Scalar(255,255,255));
 
-  std::set<std::string> GREEN_COLOR_CLASSIFIERS;
-  std::set<std::string> RED_COLOR_CLASSIFIERS;
-  std::vector<std::string> EXPRESSIONS;
-  std::vector<std::string> EMOTIONS;
-  std::vector<std::string> EMOJIS;
-  std::vector<std::string> HEAD_ANGLES;
-  std::map<affdex::Glasses, std::string> GLASSES_MAP;
-  std::map<affdex::Gender, std::string> GENDER_MAP;
-  std::map<affdex::Age, std::string> AGE_MAP;
-  std::map<affdex::Ethnicity, std::string> ETHNICITY_MAP;
 
 private:
 
   /** @brief DrawClassifierOutput Displays a classifier and associated value
-  * @param name        -- Name of the classifier
+  * @param metric      -- The classifier, its tint picks the color
   * @param value       -- Value we are trying to display
   * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
   * @param align_right -- Whether to right or left justify the text
   */
-  void drawClassifierOutput(const std::string& classifier, const float value,
+  void drawClassifierOutput(const metrics::Metric& metric, const float value,
                             const cv::Point2f& loc, bool align_right=false );
   /** @brief DrawValues displays a list of classifiers and associated values
-  * @param names       -- Names of the classifiers to show
-  * @param value       -- Value we are trying to display
+  * @param group       -- The SDK struct holding the values (e.g. &face.emotions)
+  * @param range       -- The classifiers of that struct to show
   * @param x           -- The x value of the location
   * @param padding     -- The padding value
   * @param align_right -- Whether to right or left justify the text
   */
-  void drawValues(const float * first, const std::vector<std::string> names,
+  void drawValues(const void * group, const metrics::MetricRange &range,
                   const int x, int &padding, const cv::Scalar clr, const bool align_right);
 
 
-  /** @brief DrawEqualizer displays an equalizer on screen either right or left justified at the anchor location (loc)
-  * @param name        -- Name of the classifier
-  * @param value       -- Value we are trying to display
-  * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
-  * @param align_right -- Whether to right or left justify the text
-  * @param color       -- Color
+  /** @brief Horizontal run of one sprite layer, relative to the text origin (bottom left of the baseline)
   */
-  void drawEqualizer(const std::string& name, const float value, const cv::Point2f& loc,
-                     bool align_right, cv::Scalar color);
+  struct TextRun
+  {
+    short dx;
+    short dy;
+    short length;
+    uchar layer;        // 1: shadow, 2: foreground
+  };
+
+  /** @brief Text rasterized once with cv::putText and replayed as runs
+  */
+  struct TextSprite
+  {
+    TextSprite() : advance(0), measured_width(0) {}
+    std::vector<TextRun> runs;
+    int advance;            // pen advance, to place the following text
+    int measured_width;     // cv::getTextSize width at thickness 5, used for right alignment
+  };
+
+  /** @brief RasterizeText renders text at the visualizer font, with the thick dark shadow if requested
+  */
+  static TextSprite rasterizeText(const std::string &text, const bool shadow);
 
-  /** @brief DrawText displays an text on screen either right or left justified at the anchor location (loc)
-  * @param name        -- Name of the classifier
-  * @param value       -- Value we are trying to display
-  * @param loc         -- Exact location. When aligh_right is (true/false) this should be the (upper-right, upper-left)
-  * @param align_right -- Whether to right or left justify the text
-  * @param color       -- Color
+  /** @brief CachedSprite returns the sprite of text from cache, rasterizing it on first use. Sprites are keyed by
+  * the text itself, so callers may pass any string; looking one up that is already cached does not allocate.
   */
-  void drawText(const std::string& name, const std::string& value,
-                const cv::Point2f loc, bool align_right=false, cv::Scalar color=cv::Scalar(255,255,255));
+  static const TextSprite &cachedSprite(std::map<std::string, TextSprite> &cache, const std::string &text,
+                                        const bool shadow);
 
+  /** @brief BlitSprite draws a sprite with its text origin at origin, the foreground in color
+  */
+  void blitSprite(const TextSprite &sprite, const cv::Point &origin, const cv::Scalar &color);
 
   cv::Mat img;
   cv::Mat logo;
+  std::map<std::string, TextSprite> equalizer_labels;    // with shadow, keyed by the label as drawn
+  std::map<std::string, TextSprite> text_sprites;        // without shadow
+  std::string label_text;                                // scratch for sprite lookups, keeps its capacity
+  TextSprite glyph_atlas[128];
+  static const char *const ATLAS_GLYPHS;
+  blend::PremultipliedOverlay logo_overlay;    // the resized logo, drawn over BGR frames
   bool logo_resized;
   const int spacing = 20;
   const int LOGO_PADDING = 20;
@@ -15,6 +15,11 @@
 #include "AFaceListener.hpp"
 #include "PlottingImageListener.hpp"
 #include "StatusListener.hpp"
+#include "CaptureRing.hpp"
+#include "FrameClock.hpp"
+#include "MetricsExporter.hpp"
+#include "ProcessStats.hpp"
+#include "TraceRecorder.hpp"
 
 using namespace std;
 using namespace affdex;
@@ -42,11 +47,14 @@ int main(int argsc, char ** argsv)
         int camera_id = 0;
         unsigned int nFaces = 1;
         bool draw_display = true;
+        std::string export_path;
+        int latency_report = 10;
+        int metrics_port = 0;
+        std::string metrics_file;
+        double metrics_interval = 10.0;
+        std::string trace_path;
         int faceDetectorMode = (int)FaceDetectorMode::LARGE_FACES;
 
-        float last_timestamp = -1.0f;
-        float capture_fps = -1.0f;
-
         const int precision = 2;
         std::cerr.precision(precision);
         std::cout.precision(precision);
@@ -67,6 +75,16 @@ int main(int argsc, char ** argsv)
             ("faceMode", po::value< int >(&faceDetectorMode)->default_value((int)FaceDetectorMode::LARGE_FACES), "Face detector mode (large faces vs small faces).")
             ("numFaces", po::value< unsigned int >(&nFaces)->default_value(1), "Number of faces to be tracked.")
             ("draw", po::value< bool >(&draw_display)->default_value(true), "Draw metrics on screen.")
+            ("export", po::value< std::string >(&export_path), "Also write the annotated video to this file (.avi), works with --draw false.")
+            ("latencyReport", po::value< int >(&latency_report)->default_value(10), "Seconds between reports of the throughput and the per-stage latency percentiles (0: only at exit).")
+            ("metricsPort", po::value< int >(&metrics_port)->default_value(0), "Serve Prometheus metrics at http://127.0.0.1:<port>/metrics (0: off).")
+            ("metricsFile", po::value< std::string >(&metrics_file), "Also write the Prometheus metrics to this file, and only there if the port cannot be bound.")
+            ("metricsInterval", po::value< double >(&metrics_interval)->default_value(10.0), "Seconds between rewrites of --metricsFile.")
+#ifdef _WIN32
+            ("trace", po::value< std::string >(&trace_path), "Record a timeline of the pipeline stages and write it to this file (Chrome trace JSON, open in ui.perfetto.dev) on exit and on Ctrl+Break.")
+#else //  _WIN32
+            ("trace", po::value< std::string >(&trace_path), "Record a timeline of the pipeline stages and write it to this file (Chrome trace JSON, open in ui.perfetto.dev) on exit and on SIGUSR1.")
+#endif // _WIN32
             ;
         po::variables_map args;
         try
@@ -103,6 +121,18 @@ int main(int argsc, char ** argsv)
             std::cerr << "Resolutions must be positive number." << std::endl;
             return 1;
         }
+        if (metrics_port < 0 || metrics_port > 65535)
+        {
+            std::cerr << "The metrics port must be between 0 and 65535." << std::endl;
+            return 1;
+        }
+
+        TRACE_THREAD_NAME("main");
+        std::unique_ptr<TraceSession> trace;
+        if (!trace_path.empty())
+        {
+            trace.reset(new TraceSession(trace_path));
+        }
 
         std::ofstream csvFileStream;
 
@@ -118,6 +148,13 @@ int main(int argsc, char ** argsv)
         frameDetector->setDetectAllExpressions(true);
         frameDetector->setDetectAllEmojis(true);
         frameDetector->setDetectAllAppearances(true);
+        if (!export_path.empty())
+        {
+            listenPtr->exportVideo(export_path, process_framerate);
+        }
+        // Links the SDK callbacks back to each frame's sequence number and nanosecond capture time
+        FrameTimeline timeline;
+        listenPtr->setTimeline(&timeline);
         frameDetector->setImageListener(listenPtr.get());
         frameDetector->setFaceListener(faceListenPtr.get());
         frameDetector->setProcessStatusListener(videoListenPtr.get());
@@ -127,7 +164,6 @@ int main(int argsc, char ** argsv)
         webcam.set(CV_CAP_PROP_FRAME_WIDTH, resolution[0]);
         webcam.set(CV_CAP_PROP_FRAME_HEIGHT, resolution[1]);
         std::cerr << "Setting the webcam frame rate to: " << camera_framerate << std::endl;
-        auto start_time = std::chrono::system_clock::now();
         if (!webcam.isOpened())
         {
             std::cerr << "Error opening webcam!" << std::endl;
@@ -152,45 +188,76 @@ int main(int argsc, char ** argsv)
         //Start the frame detector thread.
         frameDetector->start();
 
+        // The camera is read on its own thread, into buffers allocated once
+        CaptureRing capture(webcam);
+
+        MetricsExporter metrics;
+        metrics.addCollector([&](PrometheusText &out) { listenPtr->collectMetrics(out); });
+        metrics.addCollector([&](PrometheusText &out)
+        {
+            out.gauge("affdex_capture_ring_frames", "Camera frames captured and waiting to be submitted.", (double)capture.getReadyCount());
+        });
+        metrics.addCollector(&ProcessStats::collect);
+        metrics.start((unsigned short)metrics_port, metrics_file, metrics_interval);
+
+        PlottingImageListener::ResultLease result;
+        int64_t next_report = steadyNanos() + latency_report * 1000000000LL;
+        unsigned long long ring_dropped = 0;
         do{
-            cv::Mat img;
-            if (!webcam.read(img))    //Capture an image from the camera
+            const CaptureRing::CapturedFrame *captured;
+            {
+                TRACE_SCOPE("capture.acquire");
+                captured = capture.acquire();    //Wait for the next image from the camera
+            }
+            if (!captured)
             {
                 std::cerr << "Failed to read frame from webcam! " << std::endl;
                 break;
             }
 
-            //Calculate the Image timestamp and the capture frame rate;
-            const auto milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now() - start_time);
-            const double seconds = milliseconds.count() / 1000.f;
+            // The capture time is taken by the capture thread right after the read, on the monotonic clock
+            const FrameStamp stamp = timeline.stamp(captured->captureNs);
+            listenPtr->throughput().captured(captured->captureNs);
+            const unsigned long long dropped = capture.getDroppedCount();
+            listenPtr->throughput().dropped(dropped - ring_dropped);
+            ring_dropped = dropped;
+            const cv::Mat &img = captured->image;
 
-            // Create a frame
-            Frame f(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR, seconds);
-            capture_fps = 1.0f / (seconds - last_timestamp);
-            last_timestamp = seconds;
-            frameDetector->process(f);  //Pass the frame to detector
+            // Create a frame, process() copies the pixels so the buffer goes straight back to the capture thread
+            {
+                TRACE_SCOPE_FRAME("sdk.process", stamp.sequence);
+                Frame f(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR, stamp.timestamp);
+                frameDetector->process(f);  //Pass the frame to detector
+            }
+            capture.release(captured);
 
             // For each frame processed
-            if (listenPtr->getDataSize() > 0)
+            if (listenPtr->acquireResult(result))
             {
-
-                std::pair<Frame, std::map<FaceId, Face> > dataPoint = listenPtr->getData();
-                Frame frame = dataPoint.first;
-                std::map<FaceId, Face> faces = dataPoint.second;
-
                 // Draw metrics to the GUI
-                if (draw_display)
                 {
-                    listenPtr->draw(faces, frame);
+                    TRACE_SCOPE_FRAME("display.submit", result.sequence());
+                    listenPtr->display(result.faces(), result.frame());    // Drawn on the render thread, if drawing or exporting
                 }
 
-                std::cerr << "timestamp: " << frame.getTimestamp()
-                    << " cfps: " << listenPtr->getCaptureFrameRate()
-                    << " pfps: " << listenPtr->getProcessingFrameRate()
-                    << " faces: " << faces.size() << endl;
+                std::cerr << "frame: " << result.sequence()
+                    << " timestamp: " << result.frame().getTimestamp()
+                    << " cfps: " << result.captureFPS
+                    << " pfps: " << result.processFPS
+                    << " latency: " << result.latencyNanos() / 1e6 << "ms"
+                    << " faces: " << result.faces().size() << endl;
 
                 //Output metrics to the file
-                //listenPtr->outputToFile(faces, frame.getTimestamp());
+                //listenPtr->outputToFile(result.faces(), result.frame().getTimestamp());
+                result.release();
+            }
+            listenPtr->showLatest();    // HighGUI must run on the main thread, the render thread only draws
+
+            if (latency_report > 0 && steadyNanos() >= next_report)
+            {
+                listenPtr->reportThroughput(std::cerr);
+                listenPtr->reportLatencies(std::cerr);
+                next_report += latency_report * 1000000000LL;
             }
 
 
@@ -201,8 +268,19 @@ int main(int argsc, char ** argsv)
 #else //  _WIN32
         while (videoListenPtr->isRunning());//(cv::waitKey(20) != -1);
 #endif
+        metrics.stop();
+        capture.stop();
+        if (capture.getDroppedCount() > 0)
+        {
+            std::cerr << "Warning: " << capture.getDroppedCount() << " of " << capture.getCapturedCount() << " camera frames were dropped because processing fell behind" << std::endl;
+        }
         std::cerr << "Stopping FrameDetector Thread" << endl;
         frameDetector->stop();    //Stop frame detector thread
+        listenPtr->stopDisplay();
+        listenPtr->closeOutput();
+        trace.reset();    // writes the trace
+        listenPtr->reportThroughput(std::cerr);
+        listenPtr->reportLatencies(std::cerr);
     }
     catch (AffdexException ex)
     {
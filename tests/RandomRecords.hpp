@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "MetricSchema.hpp"
+#include "FaceRecord.hpp"
+
+namespace test
+{
+    /** @brief RandomRecords generates count rows with random metric values and appearance, one in eight without a face.
+     *  When raw_bits is set some values are arbitrary bit patterns (NaN, infinities, denormals, huge magnitudes).
+     */
+    inline std::vector<FaceRecord> randomRecords(const size_t count, const bool raw_bits, const unsigned seed = 1)
+    {
+        std::mt19937 rng(seed);
+        std::uniform_real_distribution<float> score(-100.f, 100.f);
+        std::vector<FaceRecord> records;
+        records.reserve(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            FaceRecord r;
+            r.timestamp = (float)(i / 30.0);
+            if (rng() % 8 == 0)
+            {
+                records.push_back(FaceRecord(r.timestamp));
+                continue;
+            }
+            r.hasFace = true;
+            r.id = (FaceId)(rng() % 4);
+            std::vector<float *> values;
+            values.push_back(&r.measurements.interocularDistance);
+            for (const metrics::Metric &metric : metrics::HEAD_ANGLES) values.push_back((float *)((char *)&r.measurements.orientation + metric.offset));
+            for (const metrics::Metric &metric : metrics::EMOTIONS) values.push_back((float *)((char *)&r.emotions + metric.offset));
+            for (const metrics::Metric &metric : metrics::EXPRESSIONS) values.push_back((float *)((char *)&r.expressions + metric.offset));
+            for (const metrics::Metric &metric : metrics::EMOJIS) values.push_back((float *)((char *)&r.emojis + metric.offset));
+            for (float *value : values)
+            {
+                if (raw_bits && rng() % 4 == 0)
+                {
+                    const uint32_t bits = rng();
+                    memcpy(value, &bits, sizeof(bits));
+                }
+                else
+                {
+                    *value = score(rng);
+                }
+            }
+            r.emojis.dominantEmoji = (affdex::Emoji)(rng() % 13);
+            r.appearance.glasses = (affdex::Glasses)(rng() % 2);
+            r.appearance.age = (affdex::Age)(rng() % 8);
+            r.appearance.ethnicity = (affdex::Ethnicity)(rng() % 6);
+            r.appearance.gender = (affdex::Gender)(rng() % 3);
+            records.push_back(r);
+        }
+        return records;
+    }
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "MetricSchema.hpp"
+#include "FaceRecord.hpp"
+
+/** @brief The straightforward implementations that optimized code replaced. The tests use them as oracles and the
+ *  benchmarks as baselines, so they are kept exactly as they behaved, slow parts included.
+ */
+namespace reference
+{
+    /** @brief WriteCsvRow is the ostream formatting outputToFile used before CsvRowFormatter. The stream must be set to
+     *  std::fixed and precision(4), as the output file was.
+     */
+    inline void writeCsvRow(std::ostream &out, const FaceRecord &r)
+    {
+        if (!r.hasFace)
+        {
+            out << r.timestamp << ",nan,nan,no,unknown,unknown,unknown,unknown,";
+            for (size_t i = 0; i < metrics::METRIC_COUNT; i++) out << "nan,";
+            out << std::endl;
+            return;
+        }
+
+        out << r.timestamp << ","
+            << r.id << ","
+            << r.measurements.interocularDistance << ","
+            << metrics::name(metrics::GLASSES_NAMES, r.appearance.glasses) << ","
+            << metrics::name(metrics::AGE_NAMES, r.appearance.age) << ","
+            << metrics::name(metrics::ETHNICITY_NAMES, r.appearance.ethnicity) << ","
+            << metrics::name(metrics::GENDER_NAMES, r.appearance.gender) << ","
+            << affdex::EmojiToString(r.emojis.dominantEmoji) << ",";
+
+        const float *values = (const float *)&r.measurements.orientation;
+        for (size_t i = 0; i < metrics::HEAD_ANGLES.size(); i++) out << values[i] << ",";
+        values = (const float *)&r.emotions;
+        for (size_t i = 0; i < metrics::EMOTIONS.size(); i++) out << values[i] << ",";
+        values = (const float *)&r.expressions;
+        for (size_t i = 0; i < metrics::EXPRESSIONS.size(); i++) out << values[i] << ",";
+        values = (const float *)&r.emojis;
+        for (size_t i = 0; i < metrics::EMOJIS.size(); i++) out << values[i] << ",";
+        out << std::endl;
+    }
+
+    /** @brief BlendEqualizerBlock is how drawEqualizer drew a bar block before blend::blendRect, alpha being 0.8 or 0.3
+     */
+    inline void blendEqualizerBlock(cv::Mat &img, const cv::Rect &rect, const cv::Scalar &color, const float alpha)
+    {
+        cv::Mat roi = img(rect);
+        cv::Mat block(roi.size(), CV_8UC3, color);
+        cv::addWeighted(block, alpha, roi, 1.0 - alpha, 0.0, roi);
+    }
+
+    /** @brief DrawEqualizer is Visualizer::drawEqualizer as it was before the bars were blended with blend::blendRect and
+     *  the labels blitted from sprites: each block through addWeighted, then the label with cv::putText over the bars
+     */
+    inline void drawEqualizer(cv::Mat &img, const std::string &name, const float value, const cv::Point2f &loc,
+                              const bool align_right, const cv::Scalar &color)
+    {
+        const int block_width = 8;
+        const int block_height = 10;
+        const int margin = 2;
+        const int block_size = 10;
+        const int max_blocks = 100 / block_size;
+        const int blocks = (int)std::round(value / block_size);
+        int i = loc.x, j = loc.y - 10;
+
+        cv::Point2f display_loc = loc;
+        const std::string label = align_right ? name + ": " : " :" + name;
+
+        for (int x = 0; x < max_blocks; x++)
+        {
+            cv::Scalar scalar_clr = color;
+            float alpha = 0.8f;
+            const int ii = (std::max)(float(i), 0.0f);
+            const int jj = (std::max)(float(j), 0.0f);
+            const int width = (std::min)(float(block_width), float(img.size().width - ii));
+            const int height = (std::min)(float(block_height), float(img.size().height - jj));
+            if (height < 0 || width < 0) continue;
+            if (x >= blocks)
+            {
+                alpha = 0.3f;
+                scalar_clr = cv::Scalar(186, 186, 186);
+            }
+            blendEqualizerBlock(img, cv::Rect(ii, jj, width, height), scalar_clr, alpha);
+
+            i += align_right ? -(margin + block_width) : (margin + block_width);
+        }
+        display_loc.x += align_right ? -(margin + block_width) * max_blocks : (margin + block_width) * max_blocks;
+        if (align_right)
+        {
+            int baseline = 0;
+            const cv::Size txtSize = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5f, 5, &baseline);
+            display_loc.x -= txtSize.width;
+        }
+        cv::putText(img, label, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, cv::Scalar(50, 50, 50), 5);
+        cv::putText(img, label, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, cv::Scalar(255, 255, 255), 1);
+    }
+
+    /** @brief DrawText is Visualizer::drawText as it was before the text came from sprites: label and value in one
+     *  cv::putText call, right aligned text moved left past the bars and the label
+     */
+    inline void drawText(cv::Mat &img, const std::string &name, const std::string &value, const cv::Point2f &loc,
+                         const bool align_right, const cv::Scalar &color)
+    {
+        cv::Point2f display_loc = loc;
+        const std::string label = name + ": ";
+        if (align_right)
+        {
+            int baseline = 0;
+            display_loc.x -= 100;
+            display_loc.x -= cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5f, 5, &baseline).width;
+        }
+        cv::putText(img, label + value, display_loc, cv::FONT_HERSHEY_SIMPLEX, 0.5f, color, 1);
+    }
+
+    /** @brief OverlayImage is how Visualizer drew the logo before blend::PremultipliedOverlay: a floating point blend
+     *  of every pixel, opacity taken from the foreground's last channel
+     */
+    inline void overlayImage(const cv::Mat &foreground, cv::Mat &background)
+    {
+        for (int y = 0; y < background.rows && y < foreground.rows; ++y)
+        {
+            for (int x = 0; x < background.cols && x < foreground.cols; ++x)
+            {
+                const double opacity =
+                    ((double)foreground.data[y * foreground.step + x * foreground.channels() + (foreground.channels() - 1)]) / 255.;
+                for (int c = 0; opacity > 0 && c < background.channels(); ++c)
+                {
+                    const unsigned char foregroundPx = foreground.data[y * foreground.step + x * foreground.channels() + c];
+                    const unsigned char backgroundPx = background.data[y * background.step + x * background.channels() + c];
+                    background.data[y * background.step + background.channels() * x + c] =
+                        backgroundPx * (1. - opacity) + foregroundPx * opacity;
+                }
+            }
+        }
+    }
+}
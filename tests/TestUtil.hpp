@@ -0,0 +1,56 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+/** @brief Minimal test and benchmark helpers, so the tests need nothing beyond the samples' own dependencies.
+ *  A test binary CHECKs its expectations and returns test::finish() from main; ctest reports a non-zero exit code as
+ *  a failure.
+ */
+namespace test
+{
+    inline int &failures()
+    {
+        static int count = 0;
+        return count;
+    }
+
+    inline void fail(const char *file, const int line, const char *expression)
+    {
+        if (failures()++ < 20) std::cerr << file << ":" << line << ": CHECK(" << expression << ") failed" << std::endl;
+    }
+
+    inline int finish(const char *name)
+    {
+        if (failures() == 0)
+        {
+            std::cout << name << ": passed" << std::endl;
+            return 0;
+        }
+        std::cerr << name << ": " << failures() << " check(s) failed" << std::endl;
+        return 1;
+    }
+
+    /** @brief NanosPerCall times iterations calls of body and returns the mean duration of one, in nanoseconds
+     */
+    template <typename Body>
+    double nanosPerCall(const size_t iterations, Body body)
+    {
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < iterations; i++) body();
+        const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    }
+
+    /** @brief Report prints one benchmark line comparing the optimized code with its reference
+     */
+    inline void report(const char *what, const double optimized_ns, const double reference_ns)
+    {
+        printf("%-32s %10.1f ns  (reference %10.1f ns, %.2fx)\n", what, optimized_ns, reference_ns,
+               reference_ns / optimized_ns);
+    }
+}
+
+#define CHECK(expression) \
+    do { if (!(expression)) test::fail(__FILE__, __LINE__, #expression); } while (0)
@@ -0,0 +1,161 @@
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "ColumnarResultEncoder.hpp"
+#include "ColumnarResultReader.hpp"
+#include "RandomRecords.hpp"
+#include "TestUtil.hpp"
+
+// ColumnarResultEncoder files read back through ColumnarResultReader: every column of every chunk, empty files,
+// and the checks on column types, indices and byte order
+
+static const char *PATH = "columnar_result_test.afxc";
+
+/** @brief Encode writes records to PATH, flushing a chunk every chunk_rows rows
+ */
+static void encode(const std::vector<FaceRecord> &records, const size_t chunk_rows)
+{
+    std::ofstream out(PATH, std::ios::out | std::ios::binary);
+    ColumnarResultEncoder encoder;
+    encoder.writeHeader(out);
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        encoder.append(records[i]);
+        if ((i + 1) % chunk_rows == 0) encoder.flush(out);
+    }
+    encoder.flush(out);
+}
+
+/** @brief Same tells apart every float bit pattern but treats all NaNs alike, as the encoder writes one kind of NaN
+ */
+static bool same(const float a, const float b)
+{
+    if (std::isnan(a) || std::isnan(b)) return std::isnan(a) && std::isnan(b);
+    return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static void testRoundTrip()
+{
+    const std::vector<FaceRecord> records = test::randomRecords(1000, true, 3);
+    encode(records, 128);
+    {
+        ColumnarResultReader reader(PATH);
+        CHECK(reader.rowCount() == records.size());
+        CHECK(reader.chunkCount() == 8);
+        CHECK(reader.chunkRowCount(7) == 1000 - 7 * 128);
+        CHECK(reader.columnCount() == 8 + metrics::METRIC_COUNT);
+        CHECK(reader.columnInfo(0).name == "TimeStamp" && reader.columnInfo(0).type == columnar::FLOAT64);
+
+        const std::vector<double> timestamps = reader.gather<double>(reader.findColumn("TimeStamp"));
+        const std::vector<int32_t> ids = reader.gather<int32_t>(reader.findColumn("faceId"));
+        const std::vector<float> distances = reader.gather<float>(reader.findColumn("interocularDistance"));
+        const char *appearance[] = { "glasses", "age", "ethnicity", "gender", "dominantEmoji" };
+        std::vector<std::vector<int32_t>> codes;
+        for (const char *name : appearance) codes.push_back(reader.gather<int32_t>(reader.findColumn(name)));
+        // Metric columns follow the 8 others in schema order; by position, since an expression and an emoji share a name
+        std::vector<std::vector<float>> values;
+        for (size_t m = 0; m < metrics::METRIC_COUNT; m++)
+        {
+            CHECK(reader.columnInfo(8 + m).name == metrics::ALL.begin()[m].name);
+            values.push_back(reader.gather<float>(8 + m));
+        }
+
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const FaceRecord &r = records[i];
+            CHECK(timestamps[i] == r.timestamp);
+            CHECK(ids[i] == (r.hasFace ? (int32_t)r.id : -1));
+            CHECK(same(distances[i], r.hasFace ? r.measurements.interocularDistance : NAN));
+            const int32_t expected[] = { (int32_t)r.appearance.glasses, (int32_t)r.appearance.age,
+                                         (int32_t)r.appearance.ethnicity, (int32_t)r.appearance.gender,
+                                         (int32_t)r.emojis.dominantEmoji };
+            for (size_t c = 0; c < codes.size(); c++) CHECK(codes[c][i] == (r.hasFace ? expected[c] : -1));
+
+            size_t m = 0;
+            const void *groups[] = { &r.measurements.orientation, &r.emotions, &r.expressions, &r.emojis };
+            const metrics::MetricRange ranges[] = { metrics::HEAD_ANGLES, metrics::EMOTIONS, metrics::EXPRESSIONS, metrics::EMOJIS };
+            for (int g = 0; g < 4; g++)
+            {
+                for (const metrics::Metric &metric : ranges[g])
+                {
+                    CHECK(same(values[m++][i], r.hasFace ? metrics::value(groups[g], metric) : NAN));
+                }
+            }
+        }
+
+        // A span is the chunk's slice of the gathered column
+        const ColumnSpan<float> span = reader.column<float>(3, reader.findColumn("interocularDistance"));
+        CHECK(span.size == 128);
+        CHECK(same(span[5], distances[3 * 128 + 5]));
+    }
+    std::remove(PATH);
+}
+
+static void testEmptyFile()
+{
+    encode(std::vector<FaceRecord>(), 1);
+    {
+        ColumnarResultReader reader(PATH);
+        CHECK(reader.rowCount() == 0);
+        CHECK(reader.chunkCount() == 0);
+        CHECK(reader.columnCount() == 8 + metrics::METRIC_COUNT);
+        CHECK(reader.gather<float>(reader.findColumn("joy")).empty());
+    }
+    std::remove(PATH);
+}
+
+template <typename E, typename F>
+static bool throws(const F &body)
+{
+    try
+    {
+        body();
+    }
+    catch (const E &)
+    {
+        return true;
+    }
+    return false;
+}
+
+static void testRejections()
+{
+    encode(test::randomRecords(10, false, 5), 4);
+    {
+        ColumnarResultReader reader(PATH);
+        const int ids = reader.findColumn("faceId");
+        const int joy = reader.findColumn("joy");
+        CHECK(throws<std::runtime_error>([&]() { reader.column<int32_t>(0, joy); }));    // same size, other type
+        CHECK(throws<std::runtime_error>([&]() { reader.column<float>(0, ids); }));
+        CHECK(throws<std::runtime_error>([&]() { reader.column<double>(0, joy); }));
+        CHECK(throws<std::out_of_range>([&]() { reader.column<float>(reader.chunkCount(), joy); }));
+        CHECK(throws<std::out_of_range>([&]() { reader.column<float>(0, reader.columnCount()); }));
+        CHECK(throws<std::out_of_range>([&]() { reader.chunkRowCount(reader.chunkCount()); }));
+        CHECK(throws<std::out_of_range>([&]() { reader.columnInfo(reader.columnCount()); }));
+    }
+
+    // The same file as a host of the other byte order would have written it
+    {
+        std::fstream file(PATH, std::ios::in | std::ios::out | std::ios::binary);
+        columnar::FileHeader header;
+        file.read((char *)&header, sizeof(header));
+        header.byteOrder = 0x04030201;
+        file.seekp(0);
+        file.write((const char *)&header, sizeof(header));
+    }
+    CHECK(throws<std::runtime_error>([&]() { ColumnarResultReader reader(PATH); }));
+    std::remove(PATH);
+}
+
+int main()
+{
+    testRoundTrip();
+    testEmptyFile();
+    testRejections();
+    return test::finish("columnar_result_test");
+}
@@ -0,0 +1,36 @@
+#include <sstream>
+#include <vector>
+
+#include "CsvRowFormatter.hpp"
+#include "RandomRecords.hpp"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// Cost of formatting one CSV row with CsvRowFormatter versus the ostream formatting it replaced
+
+int main()
+{
+    const std::vector<FaceRecord> records = test::randomRecords(20000, false);
+    const int rounds = 20;
+    size_t bytes = 0;
+
+    CsvRowFormatter formatter;
+    const double optimized = test::nanosPerCall(rounds, [&]()
+    {
+        for (const FaceRecord &record : records) formatter.appendRow(record);
+        bytes += formatter.size();
+        formatter.clear();
+    }) / records.size();
+
+    const double reference = test::nanosPerCall(rounds, [&]()
+    {
+        std::ostringstream out;
+        out.precision(4);
+        out << std::fixed;
+        for (const FaceRecord &record : records) reference::writeCsvRow(out, record);
+        bytes += out.str().size();
+    }) / records.size();
+
+    test::report("CSV row", optimized, reference);
+    return bytes > 0 ? 0 : 1;
+}
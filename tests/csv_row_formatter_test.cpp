@@ -0,0 +1,108 @@
+#include <cstring>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CsvRowFormatter.hpp"
+#include "RandomRecords.hpp"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// CsvRowFormatter must write exactly the bytes of the ostream formatting it replaced.
+
+static std::string formatted(const float value)
+{
+    CsvRowFormatter formatter;
+    formatter.appendFixed(value);
+    return std::string(formatter.data(), formatter.size());
+}
+
+static std::string streamed(const float value)
+{
+    std::ostringstream out;
+    out.precision(4);
+    out << std::fixed << value;
+    return out.str();
+}
+
+static void testEdgeValues()
+{
+    const float values[] = {
+        0.f, -0.f, 0.03125f, -0.03125f, 1e-5f, -1e-5f, 0.00005f, 0.00015f, 0.00025f, 99.99995f, 100.f,
+        123456.78f, 1e20f, -3.4e38f, std::numeric_limits<float>::denorm_min(), std::numeric_limits<float>::max(),
+        std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity(),
+        std::numeric_limits<float>::quiet_NaN(), -std::numeric_limits<float>::quiet_NaN()
+    };
+    for (const float value : values) CHECK(formatted(value) == streamed(value));
+}
+
+static void testRandomValues()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> score(-200.f, 200.f);
+    for (int i = 0; i < 1000000; i++)
+    {
+        const uint32_t bits = rng();
+        float value;
+        memcpy(&value, &bits, sizeof(bits));
+        CHECK(formatted(value) == streamed(value));
+        value = score(rng);
+        CHECK(formatted(value) == streamed(value));
+    }
+}
+
+static void testDoubles()
+{
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> seconds(0, 1e5);
+    CsvRowFormatter formatter;
+    for (int i = 0; i < 100000; i++)
+    {
+        const double value = i % 2 ? seconds(rng) : (double)(float)seconds(rng);
+        std::ostringstream out;
+        out.precision(4);
+        out << std::fixed << value;
+        formatter.clear();
+        formatter.appendFixed(value);
+        CHECK(std::string(formatter.data(), formatter.size()) == out.str());
+    }
+}
+
+static void testIntegers()
+{
+    const long long values[] = { 0, -1, 42, -9223372036854775807LL - 1, 9223372036854775807LL };
+    CsvRowFormatter formatter;
+    for (const long long value : values)
+    {
+        formatter.clear();
+        formatter.appendInt(value);
+        CHECK(std::string(formatter.data(), formatter.size()) == std::to_string(value));
+    }
+}
+
+static void testRows()
+{
+    const std::vector<FaceRecord> records = test::randomRecords(20000, true);
+    CsvRowFormatter formatter;
+    std::ostringstream out;
+    out.precision(4);
+    out << std::fixed;
+    for (const FaceRecord &record : records)
+    {
+        formatter.appendRow(record);
+        reference::writeCsvRow(out, record);
+    }
+    CHECK(std::string(formatter.data(), formatter.size()) == out.str());
+}
+
+int main()
+{
+    testEdgeValues();
+    testRandomValues();
+    testDoubles();
+    testIntegers();
+    testRows();
+    return test::finish("csv_row_formatter_test");
+}
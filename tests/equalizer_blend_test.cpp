@@ -0,0 +1,137 @@
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+#include "AlphaBlend.hpp"
+#include "Visualizer.h"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// blend::blendRect must match the cv::addWeighted rendering of the equalizer blocks within +-1, and the SSE2 path of
+// blend::blendRow the scalar formula exactly. Whole labelled equalizers must look as they did, labels over the bars.
+
+static cv::Mat randomImage(std::mt19937 &rng, const int rows, const int cols)
+{
+    cv::Mat img(rows, cols, CV_8UC3);
+    for (int y = 0; y < rows; y++)
+    {
+        uchar *row = img.ptr<uchar>(y);
+        for (int x = 0; x < cols * 3; x++) row[x] = (uchar)rng();
+    }
+    return img;
+}
+
+static int maxDifference(const cv::Mat &a, const cv::Mat &b)
+{
+    int worst = 0;
+    for (int y = 0; y < a.rows; y++)
+    {
+        for (int x = 0; x < a.cols * 3; x++) worst = (std::max)(worst, std::abs(a.ptr<uchar>(y)[x] - b.ptr<uchar>(y)[x]));
+    }
+    return worst;
+}
+
+static void testBlendRowMatchesScalar()
+{
+    std::mt19937 rng(3);
+    std::vector<uchar> dst(80), expected(80);
+    std::vector<uint16_t> premul(80), inv(80);
+    for (int round = 0; round < 200; round++)
+    {
+        for (int n = 0; n <= 64; n++)
+        {
+            const int offset = (int)(rng() % 8);    // unaligned starts as well
+            for (int k = 0; k < n; k++)
+            {
+                const int alpha = (int)(rng() % 257);
+                dst[offset + k] = expected[offset + k] = (uchar)rng();
+                premul[k] = (uint16_t)((uchar)rng() * alpha + 128);
+                inv[k] = (uint16_t)(256 - alpha);
+            }
+            blend::blendRow(&dst[offset], &premul[0], &inv[0], n);
+            for (int k = 0; k < n; k++)
+            {
+                expected[offset + k] = (uchar)((premul[k] + expected[offset + k] * inv[k]) >> 8);
+                CHECK(dst[offset + k] == expected[offset + k]);
+            }
+        }
+    }
+}
+
+static void testBlendRectMatchesAddWeighted()
+{
+    std::mt19937 rng(5);
+    const float alphas[] = { 0.8f, 0.3f };
+    for (int round = 0; round < 2000; round++)
+    {
+        const cv::Mat original = randomImage(rng, 24, 48);
+        // Equalizer blocks are 8 pixels wide, narrower at the image edge; wider ones take several chunks
+        const int width = 1 + (int)(rng() % 20);
+        const int height = 1 + (int)(rng() % 10);
+        const cv::Rect rect((int)(rng() % (48 - width + 1)), (int)(rng() % (24 - height + 1)), width, height);
+        const float alpha = alphas[round % 2];
+        const cv::Scalar color = round % 3 == 0 ? cv::Scalar(186, 186, 186) : cv::Scalar(rng() % 256, rng() % 256, rng() % 256);
+
+        cv::Mat expected = original.clone();
+        reference::blendEqualizerBlock(expected, rect, color, alpha);
+        cv::Mat blended = original.clone();
+        blend::blendRect(blended, rect, color, cvRound(alpha * 256));
+
+        CHECK(maxDifference(blended, expected) <= 1);
+        // Pixels outside the block are untouched
+        cv::Mat outside = blended.clone();
+        cv::Mat block = outside(rect);
+        original(rect).copyTo(block);
+        CHECK(maxDifference(outside, original) == 0);
+    }
+}
+
+static void testBlendRectOnRoi()
+{
+    // The visualizer blends into frames that may be views of larger buffers, with a step wider than the row
+    std::mt19937 rng(9);
+    cv::Mat parent = randomImage(rng, 40, 64);
+    cv::Mat view = parent(cv::Rect(5, 3, 37, 30));
+    cv::Mat expected = view.clone();
+    const cv::Rect rect(29, 20, 8, 10);
+    reference::blendEqualizerBlock(expected, rect, cv::Scalar(0, 255, 0), 0.8f);
+    blend::blendRect(view, rect, cv::Scalar(0, 255, 0), cvRound(0.8f * 256));
+    CHECK(maxDifference(view, expected) <= 1);
+}
+
+static void testLabelledEqualizersMatchReference()
+{
+    std::mt19937 rng(13);
+    const cv::Scalar colors[] = { cv::Scalar(255, 255, 255), cv::Scalar(0, 0, 255), cv::Scalar(0, 255, 0) };
+    Visualizer visualizer;
+    for (int round = 0; round < 20; round++)
+    {
+        const cv::Mat original = randomImage(rng, 240, 480);
+        cv::Mat expected = original.clone();
+        cv::Mat drawn = original.clone();
+        visualizer.updateImage(expected);    // the logo, so both images start alike
+        visualizer.updateImage(drawn);
+
+        // Scattered so that labels and bars of different equalizers overlap, which is where the drawing order shows
+        for (const metrics::Metric &metric : metrics::EXPRESSIONS)
+        {
+            const bool align_right = rng() % 2 == 0;
+            const cv::Point2f loc((float)(rng() % 480), (float)(10 + rng() % 230));
+            const float value = (float)(rng() % 1010) / 10.f;
+            const cv::Scalar color = colors[rng() % 3];
+            reference::drawEqualizer(expected, metric.name, value, loc, align_right, color);
+            visualizer.drawEqualizer(metric.name, value, loc, align_right, color);
+        }
+        CHECK(maxDifference(drawn, expected) <= 1);
+    }
+}
+
+int main()
+{
+    testBlendRowMatchesScalar();
+    testBlendRectMatchesAddWeighted();
+    testBlendRectOnRoi();
+    testLabelledEqualizersMatchReference();
+    return test::finish("equalizer_blend_test");
+}
@@ -0,0 +1,62 @@
+#include <map>
+#include <vector>
+
+#include "FrameResult.hpp"
+#include "TestUtil.hpp"
+
+// FrameResult reuses its pooled faces, feature points included, and reports every allocation it makes
+
+static std::map<FaceId, Face> detectedFaces(const int count, const size_t points)
+{
+    std::map<FaceId, Face> faces;
+    for (int id = 0; id < count; id++)
+    {
+        Face face;
+        face.id = id;
+        face.featurePoints.resize(points);
+        for (size_t p = 0; p < points; p++) face.featurePoints[p].x = (float)(id * 100 + p);
+        faces[id] = face;
+    }
+    return faces;
+}
+
+static void testAssignReusesFeaturePoints()
+{
+    FrameResult result;
+    Frame image;
+    CHECK(result.assign(detectedFaces(2, 34), image));    // the first frame fills the pool
+
+    const FeaturePoint *storage = result.faces().begin()[1].featurePoints.data();
+    for (int frame = 0; frame < 10; frame++)
+    {
+        std::map<FaceId, Face> faces = detectedFaces(2, 34);
+        CHECK(!result.assign(faces, image));
+        CHECK(result.faces().size() == 2);
+        CHECK(result.faces().begin()[1].featurePoints.data() == storage);
+        CHECK(result.faces().begin()[1].featurePoints[33].x == 133.f);
+        CHECK(faces[1].featurePoints.size() == 34);    // the SDK's faces are copied, not consumed
+    }
+
+    CHECK(!result.assign(detectedFaces(1, 20), image));    // fewer faces or points fit in the pool
+    CHECK(result.faces().size() == 1);
+    CHECK(result.assign(detectedFaces(1, 40), image));     // more points than ever before
+    CHECK(result.assign(detectedFaces(3, 34), image));     // more faces than ever before
+    CHECK(!result.assign(detectedFaces(3, 34), image));
+}
+
+static void testCopyFromCountsAllocations()
+{
+    FrameResult source, copy;
+    Frame image;
+    source.assign(detectedFaces(2, 34), image);
+    CHECK(copy.copyFrom(source.faces(), source.frame));
+    CHECK(!copy.copyFrom(source.faces(), source.frame));
+    CHECK(copy.faces().begin()[0].featurePoints[10].x == 10.f);
+}
+
+int main()
+{
+    testAssignReusesFeaturePoints();
+    testCopyFromCountsAllocations();
+    return test::finish("frame_result_test");
+}
@@ -0,0 +1,98 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "FrameClock.hpp"
+#include "TestUtil.hpp"
+
+// FrameTimeline must find every one of its last capacity stamps, and only ever return the stamp that was asked for
+
+static void testFindsRecentStamps()
+{
+    const size_t capacity = 64;
+    FrameTimeline timeline(capacity);
+    std::vector<FrameStamp> stamps;
+    int64_t ns = 1000;
+    for (int i = 0; i < 5000; i++)
+    {
+        ns += (i % 7 == 0) ? 1 : 33333333;    // some captures closer together than float precision can tell apart
+        stamps.push_back(timeline.stamp(ns));
+        CHECK(stamps.back().sequence == (uint64_t)i);
+        CHECK(i == 0 || stamps[i].timestamp > stamps[i - 1].timestamp);
+
+        for (size_t back = 0; back < capacity && back <= (size_t)i; back++)
+        {
+            const FrameStamp &expected = stamps[i - back];
+            FrameStamp found;
+            CHECK(timeline.find(expected.timestamp, found));
+            CHECK(found.sequence == expected.sequence && found.captureNs == expected.captureNs);
+        }
+    }
+    FrameStamp found;
+    CHECK(!timeline.find(-1.0f, found));
+    CHECK(!timeline.find(stamps.back().timestamp + 1.0f, found));
+}
+
+static void testLateTimestampsStayClose()
+{
+    // After days of capture a float step is about 16 milliseconds: moving timestamps to free slots must not make
+    // them drift away from the capture times at 30 fps
+    FrameTimeline timeline(1024);
+    timeline.stamp(0);
+    const int64_t start = 3 * 86400LL * 1000000000LL;
+    float last = 0;
+    double worst = 0;
+    for (int i = 0; i < 100000; i++)
+    {
+        const int64_t ns = start + i * 33333333LL;
+        const FrameStamp s = timeline.stamp(ns);
+        CHECK(s.timestamp > last);
+        last = s.timestamp;
+        worst = (std::max)(worst, (double)s.timestamp - ns * 1e-9);
+    }
+    CHECK(worst < 0.1);
+}
+
+static void testConcurrentFind()
+{
+    // The consumer looks stamps up while the capture thread keeps stamping
+    FrameTimeline timeline(128);
+    std::atomic<uint32_t> published(0);
+    std::vector<float> timestamps(200000);
+    std::atomic<bool> done(false);
+    std::atomic<long> mismatches(0), misses(0);
+
+    std::thread reader([&]()
+    {
+        while (!done.load())
+        {
+            const uint32_t n = published.load(std::memory_order_acquire);
+            if (n == 0) continue;
+            const uint32_t wanted = n - 1 - (n * 7919u) % (n < 64 ? n : 64);
+            FrameStamp found;
+            if (!timeline.find(timestamps[wanted], found))
+            {
+                if (published.load() <= wanted + 128) misses++;    // only stamps lapped meanwhile may be gone
+            }
+            else if (found.sequence != wanted || found.captureNs != (int64_t)wanted * 1000) mismatches++;
+        }
+    });
+    for (uint32_t i = 0; i < timestamps.size(); i++)
+    {
+        timestamps[i] = timeline.stamp((int64_t)i * 1000).timestamp;
+        published.store(i + 1, std::memory_order_release);
+    }
+    done = true;
+    reader.join();
+    CHECK(mismatches.load() == 0);
+    CHECK(misses.load() == 0);
+}
+
+int main()
+{
+    testFindsRecentStamps();
+    testLateTimestampsStayClose();
+    testConcurrentFind();
+    return test::finish("frame_timeline_test");
+}
@@ -0,0 +1,43 @@
+#include <random>
+#include <opencv2/core/core.hpp>
+
+#include "AlphaBlend.hpp"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// Cost of drawing the logo on a 720p frame with blend::PremultipliedOverlay versus the overlayImage it replaced
+
+int main()
+{
+    std::mt19937 rng(1);
+    // A logo a quarter of the frame wide, mostly transparent or opaque with translucent edges
+    const int rows = 96, cols = 320;
+    cv::Mat logo(rows, cols, CV_8UC4);
+    for (int y = 0; y < rows; y++)
+    {
+        uchar *row = logo.ptr<uchar>(y);
+        for (int x = 0; x < cols; x++)
+        {
+            const bool inside = (x / 16 + y / 16) % 2 == 0;
+            const bool edge = x % 16 == 0 || x % 16 == 15;
+            for (int c = 0; c < 3; c++) row[x * 4 + c] = (uchar)rng();
+            row[x * 4 + 3] = edge ? (uchar)(64 + rng() % 128) : inside ? 255 : 0;
+        }
+    }
+
+    cv::Mat frame(720, 1280, CV_8UC3);
+    for (int y = 0; y < frame.rows; y++)
+    {
+        for (int x = 0; x < frame.cols * 3; x++) frame.ptr<uchar>(y)[x] = (uchar)rng();
+    }
+    cv::Mat roi = frame(cv::Rect(frame.cols - cols - 10, 10, cols, rows));
+
+    blend::PremultipliedOverlay overlay;
+    overlay.prepare(logo);
+    const int iterations = 2000;
+    const double optimized = test::nanosPerCall(iterations, [&]() { overlay.composite(roi); });
+    const double reference = test::nanosPerCall(iterations, [&]() { reference::overlayImage(logo, roi); });
+
+    test::report("logo composite (320x96)", optimized, reference);
+    return 0;
+}
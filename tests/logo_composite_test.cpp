@@ -0,0 +1,116 @@
+#include <cstdlib>
+#include <random>
+#include <opencv2/core/core.hpp>
+
+#include "AlphaBlend.hpp"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// blend::PremultipliedOverlay must draw the logo like the floating point overlayImage it replaced, within +-1
+
+static cv::Mat randomImage(std::mt19937 &rng, const int rows, const int cols, const int type)
+{
+    cv::Mat img(rows, cols, type);
+    for (int y = 0; y < rows; y++)
+    {
+        uchar *row = img.ptr<uchar>(y);
+        for (int x = 0; x < cols * img.channels(); x++) row[x] = (uchar)rng();
+    }
+    return img;
+}
+
+/** @brief RandomLogo makes a BGRA image whose opacity is mostly 0 or 255 with translucent edges, like a real logo,
+ *  or entirely random
+ */
+static cv::Mat randomLogo(std::mt19937 &rng, const int rows, const int cols, const bool realistic)
+{
+    cv::Mat logo = randomImage(rng, rows, cols, CV_8UC4);
+    if (!realistic) return logo;
+    for (int y = 0; y < rows; y++)
+    {
+        uchar *row = logo.ptr<uchar>(y);
+        int run = 0;
+        uchar alpha = 0;
+        for (int x = 0; x < cols; x++)
+        {
+            if (run-- <= 0)
+            {
+                run = (int)(rng() % 12);
+                const unsigned pick = rng() % 4;
+                alpha = pick == 0 ? 0 : pick == 1 ? 255 : (uchar)rng();
+            }
+            row[x * 4 + 3] = alpha;
+        }
+    }
+    return logo;
+}
+
+static int maxDifference(const cv::Mat &a, const cv::Mat &b)
+{
+    int worst = 0;
+    for (int y = 0; y < a.rows; y++)
+    {
+        for (int x = 0; x < a.cols * a.channels(); x++) worst = (std::max)(worst, std::abs(a.ptr<uchar>(y)[x] - b.ptr<uchar>(y)[x]));
+    }
+    return worst;
+}
+
+static void testMatchesOverlayImage()
+{
+    std::mt19937 rng(13);
+    for (int round = 0; round < 500; round++)
+    {
+        const int rows = 1 + (int)(rng() % 40);
+        const int cols = 1 + (int)(rng() % 70);
+        const cv::Mat logo = randomLogo(rng, rows, cols, round % 2 == 0);
+        const cv::Mat frame = randomImage(rng, rows + 20, cols + 30, CV_8UC3);
+        // The logo goes into an ROI of the frame, as in Visualizer::updateImage
+        const cv::Rect where(frame.cols - cols - 10, 10, cols, rows);
+
+        blend::PremultipliedOverlay overlay;
+        overlay.prepare(logo);
+        cv::Mat composited = frame.clone();
+        cv::Mat roi = composited(where);
+        overlay.composite(roi);
+
+        cv::Mat expected = frame.clone();
+        cv::Mat expected_roi = expected(where);
+        reference::overlayImage(logo, expected_roi);
+
+        CHECK(maxDifference(composited, expected) <= 1);
+    }
+}
+
+static void testOpacityExtremes()
+{
+    // Fully transparent pixels leave the frame alone and opaque ones replace it exactly
+    std::mt19937 rng(17);
+    cv::Mat logo = randomImage(rng, 4, 33, CV_8UC4);
+    for (int y = 0; y < logo.rows; y++)
+    {
+        for (int x = 0; x < logo.cols; x++) logo.ptr<uchar>(y)[x * 4 + 3] = y % 2 ? 255 : 0;
+    }
+    const cv::Mat frame = randomImage(rng, 4, 33, CV_8UC3);
+    blend::PremultipliedOverlay overlay;
+    overlay.prepare(logo);
+    cv::Mat composited = frame.clone();
+    overlay.composite(composited);
+    for (int y = 0; y < logo.rows; y++)
+    {
+        for (int x = 0; x < logo.cols; x++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                const uchar expected = y % 2 ? logo.ptr<uchar>(y)[x * 4 + c] : frame.ptr<uchar>(y)[x * 3 + c];
+                CHECK(composited.ptr<uchar>(y)[x * 3 + c] == expected);
+            }
+        }
+    }
+}
+
+int main()
+{
+    testMatchesOverlayImage();
+    testOpacityExtremes();
+    return test::finish("logo_composite_test");
+}
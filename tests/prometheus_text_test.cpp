@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "PrometheusText.hpp"
+#include "TestUtil.hpp"
+
+// PrometheusText headers, label escaping and the cumulative _bucket/_sum/_count samples of a histogram
+
+static std::vector<std::string> lines(const std::string &text)
+{
+    std::vector<std::string> out;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) out.push_back(line);
+    return out;
+}
+
+/** @brief Value returns the sample whose name and labels are exactly series, NAN if the page has none
+ */
+static double value(const std::string &text, const std::string &series)
+{
+    for (const std::string &line : lines(text))
+    {
+        if (line.compare(0, series.size() + 1, series + " ") == 0) return atof(line.c_str() + series.size() + 1);
+    }
+    return NAN;
+}
+
+static void testFamiliesAndEscaping()
+{
+    CHECK(PrometheusText::label("stage", "draw") == "stage=\"draw\"");
+    CHECK(PrometheusText::label("path", "C:\\videos\\a \"b\"\nc") == "path=\"C:\\\\videos\\\\a \\\"b\\\"\\nc\"");
+
+    PrometheusText page;
+    page.counter("affdex_frames_dropped_total", "Frames dropped.", 42);
+    page.family("affdex_queue_depth", "gauge", "Items waiting.");
+    page.sample("affdex_queue_depth", 0.25, PrometheusText::label("queue", "a\"b"));
+    const std::vector<std::string> text = lines(page.str());
+    CHECK(text.size() == 6);
+    CHECK(text[0] == "# HELP affdex_frames_dropped_total Frames dropped.");
+    CHECK(text[1] == "# TYPE affdex_frames_dropped_total counter");
+    CHECK(text[2] == "affdex_frames_dropped_total 42");
+    CHECK(text[3] == "# HELP affdex_queue_depth Items waiting.");
+    CHECK(text[4] == "# TYPE affdex_queue_depth gauge");
+    CHECK(text[5] == "affdex_queue_depth{queue=\"a\\\"b\"} 0.25");
+}
+
+static void testHistogramIsCumulative()
+{
+    LatencyHistogram latency;
+    const int64_t ns[] = { 200000, 3000000, 3000000, 70000000, 20000000000LL };    // 0.2ms, 3ms twice, 70ms, 20s
+    for (const int64_t v : ns) latency.record(v);
+    latency.drain();    // scrapes report totals since construction, whatever the periodic reports drained
+
+    PrometheusText page;
+    page.family("affdex_stage_latency_seconds", "histogram", "Latency.");
+    page.histogram("affdex_stage_latency_seconds", latency, PrometheusText::label("stage", "draw"));
+    const std::string &text = page.str();
+
+    const char *bounds[] = { "0.0005", "0.001", "0.0025", "0.005", "0.01", "0.025", "0.05", "0.1", "0.25", "0.5",
+                             "1", "2.5", "5", "10", "+Inf" };
+    const double expected[] = { 1, 1, 1, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 5 };
+    double previous = 0;
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++)
+    {
+        const double count = value(text, std::string("affdex_stage_latency_seconds_bucket{stage=\"draw\",le=\"") + bounds[b] + "\"}");
+        CHECK(count == expected[b]);
+        CHECK(count >= previous);
+        previous = count;
+    }
+    const double total = value(text, "affdex_stage_latency_seconds_count{stage=\"draw\"}");
+    CHECK(total == 5);
+    CHECK(total == value(text, "affdex_stage_latency_seconds_bucket{stage=\"draw\",le=\"+Inf\"}"));
+    CHECK(std::fabs(value(text, "affdex_stage_latency_seconds_sum{stage=\"draw\"}") - 20.0762) < 1e-9);
+
+    // More records only ever raise the counts
+    latency.record(1500000);
+    PrometheusText later;
+    later.histogram("affdex_stage_latency_seconds", latency);
+    CHECK(value(later.str(), "affdex_stage_latency_seconds_bucket{le=\"0.001\"}") == 1);
+    CHECK(value(later.str(), "affdex_stage_latency_seconds_bucket{le=\"0.0025\"}") == 2);
+    CHECK(value(later.str(), "affdex_stage_latency_seconds_count") == 6);
+}
+
+int main()
+{
+    testFamiliesAndEscaping();
+    testHistogramIsCumulative();
+    return test::finish("prometheus_text_test");
+}
@@ -0,0 +1,89 @@
+#include <atomic>
+#include <cmath>
+#include <thread>
+
+#include "ThroughputStats.hpp"
+#include "TestUtil.hpp"
+
+// RateMeter windows and EWMA, reset() from another thread, and ThroughputStats reads racing the single writer
+
+static const int64_t SECOND = 1000000000LL;
+
+static void testRates()
+{
+    RateMeter meter;
+    const int64_t start = 1000 * SECOND;
+    for (int i = 0; i < 700; i++) meter.record(start + i * SECOND / 10);    // 10 per second for 70 seconds
+    const int64_t now = start + 70 * SECOND;
+    CHECK(meter.total() == 700);
+    CHECK(meter.rate(1, now) == 10.0);
+    CHECK(meter.rate(10, now) == 10.0);
+    CHECK(meter.rate(60, now) == 10.0);
+    CHECK(std::fabs(meter.ewma(now - SECOND / 10) - 10.0) < 0.01);
+    CHECK(meter.ewma(now + 5 * SECOND) < meter.ewma(now));    // decays while idle
+
+    // A short run shortens the window instead of diluting the rate
+    RateMeter young;
+    for (int i = 0; i < 30; i++) young.record(start + i * SECOND / 10);
+    CHECK(young.rate(60, start + 3 * SECOND) == 10.0);
+}
+
+static void testResetIsAppliedByTheWriter()
+{
+    RateMeter meter;
+    CHECK(meter.record(5 * SECOND) == -1);
+    CHECK(meter.record(6 * SECOND) == 5 * SECOND);
+    std::thread other([&]() { meter.reset(); });
+    other.join();
+    // Reads show the reset at once, the writer clears its state on its next event
+    CHECK(meter.total() == 0);
+    CHECK(meter.ewma(6 * SECOND) == 0.0);
+    CHECK(meter.rate(1, 7 * SECOND) == 0.0);
+    CHECK(meter.record(8 * SECOND) == -1);
+    CHECK(meter.record(9 * SECOND) == 8 * SECOND);
+}
+
+static void testConcurrentReads()
+{
+    ThroughputStats stats;
+    const uint64_t events = 2000000;
+    std::atomic<bool> done(false);
+    bool monotonic = true;
+    std::thread reader([&]()
+    {
+        uint64_t previous = 0;
+        while (!done.load())
+        {
+            const uint64_t total = stats.processedCount();
+            if (total < previous) monotonic = false;
+            previous = total;
+            const int64_t now = steadyNanos();
+            const RateMeter &meter = stats.processedMeter();
+            if (meter.rate(1, now) < 0 || meter.ewma(now) < 0) monotonic = false;
+        }
+    });
+    for (uint64_t i = 0; i < events; i++) stats.processed();
+    done = true;
+    reader.join();
+    CHECK(monotonic);
+    CHECK(stats.processedCount() == events);
+    CHECK(stats.capturedCount() == 0);
+    stats.dropped(3);
+    stats.reset();
+    // Totals, rates and drops all read zero at once, before the writer has applied the reset
+    const int64_t now = steadyNanos();
+    CHECK(stats.processedCount() == 0);
+    CHECK(stats.processedMeter().rate(1, now) == 0.0);
+    CHECK(stats.processedMeter().ewma(now) == 0.0);
+    CHECK(stats.droppedCount() == 0);
+    CHECK(stats.processed() == -1);
+    CHECK(stats.processedCount() == 1);
+}
+
+int main()
+{
+    testRates();
+    testResetIsAppliedByTheWriter();
+    testConcurrentReads();
+    return test::finish("rate_meter_test");
+}
@@ -0,0 +1,97 @@
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <opencv2/core/core.hpp>
+
+#include "Visualizer.h"
+#include "Reference.hpp"
+#include "TestUtil.hpp"
+
+// Labels blitted from the sprite cache must match cv::putText within +-1, and the cache must be keyed by the text,
+// not by where it is stored
+
+static cv::Mat randomImage(std::mt19937 &rng, const int rows, const int cols)
+{
+    cv::Mat img(rows, cols, CV_8UC3);
+    for (int y = 0; y < rows; y++)
+    {
+        uchar *row = img.ptr<uchar>(y);
+        for (int x = 0; x < cols * 3; x++) row[x] = (uchar)rng();
+    }
+    return img;
+}
+
+static int maxDifference(const cv::Mat &a, const cv::Mat &b)
+{
+    int worst = 0;
+    for (int y = 0; y < a.rows; y++)
+    {
+        for (int x = 0; x < a.cols * 3; x++) worst = (std::max)(worst, std::abs(a.ptr<uchar>(y)[x] - b.ptr<uchar>(y)[x]));
+    }
+    return worst;
+}
+
+/** @brief Canvas returns the same random image twice, each with the logo already composited so that only the text differs
+ */
+static void canvas(std::mt19937 &rng, Visualizer &visualizer, cv::Mat &expected, cv::Mat &drawn)
+{
+    expected = randomImage(rng, 120, 320);
+    drawn = expected.clone();
+    visualizer.updateImage(expected);
+    visualizer.updateImage(drawn);
+}
+
+static void testCachedLabelsMatchPutText()
+{
+    std::mt19937 rng(17);
+    const char *names[] = { "gender", "age", "ethnicity", "pitch", "yaw", "roll" };
+    const cv::Scalar colors[] = { cv::Scalar(255, 255, 255), cv::Scalar(0, 0, 255), cv::Scalar(0, 255, 0) };
+    Visualizer visualizer;
+    cv::Mat expected, drawn;
+    // Twice through, so the second round blits the sprites the first one cached
+    for (int round = 0; round < 2; round++)
+    {
+        for (const char *name : names)
+        {
+            for (const bool align_right : { false, true })
+            {
+                canvas(rng, visualizer, expected, drawn);
+                const cv::Point2f loc(align_right ? 300.f : 20.f, (float)(20 + rng() % 80));
+                const cv::Scalar color = colors[rng() % 3];
+                reference::drawText(expected, name, "", loc, align_right, color);
+                visualizer.drawText(name, "", loc, align_right, color);
+                CHECK(maxDifference(drawn, expected) <= 1);
+            }
+        }
+    }
+}
+
+static void testCacheIsKeyedByContent()
+{
+    std::mt19937 rng(19);
+    Visualizer visualizer;
+    cv::Mat expected, drawn;
+    char name[16];
+    const char *contents[] = { "gender", "age", "gender" };
+    for (const char *content : contents)
+    {
+        strcpy(name, content);    // one buffer, changing text
+
+        canvas(rng, visualizer, expected, drawn);
+        reference::drawText(expected, content, "", cv::Point2f(20, 50), false, cv::Scalar(255, 255, 255));
+        visualizer.drawText(name, "", cv::Point2f(20, 50), false, cv::Scalar(255, 255, 255));
+        CHECK(maxDifference(drawn, expected) <= 1);
+
+        canvas(rng, visualizer, expected, drawn);
+        reference::drawEqualizer(expected, content, 50.f, cv::Point2f(300, 50), true, cv::Scalar(0, 0, 255));
+        visualizer.drawEqualizer(name, 50.f, cv::Point2f(300, 50), true, cv::Scalar(0, 0, 255));
+        CHECK(maxDifference(drawn, expected) <= 1);
+    }
+}
+
+int main()
+{
+    testCachedLabelsMatchPutText();
+    testCacheIsKeyedByContent();
+    return test::finish("text_sprite_test");
+}
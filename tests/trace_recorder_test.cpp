@@ -0,0 +1,128 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TraceRecorder.hpp"
+#include "TestUtil.hpp"
+
+// TraceRecorder: buffers of exited threads are reused, what each owner recorded is dumped under its name, and dumps
+// racing a thread that laps its buffer only write whole events
+
+static const char *TRACE_PATH = "trace_recorder_test.json";
+
+static std::string dumpTrace()
+{
+    CHECK(TraceRecorder::instance().dump(TRACE_PATH));
+    std::ifstream in(TRACE_PATH);
+    std::stringstream text;
+    text << in.rdbuf();
+    in.close();
+    std::remove(TRACE_PATH);
+    return text.str();
+}
+
+static size_t occurrences(const std::string &text, const std::string &what)
+{
+    size_t count = 0;
+    for (size_t at = text.find(what); at != std::string::npos; at = text.find(what, at + what.size())) count++;
+    return count;
+}
+
+static void recordOn(const char *thread_name, const int events)
+{
+    TRACE_THREAD_NAME(thread_name);
+    for (int i = 0; i < events; i++) TraceRecorder::instance().complete("span", 1000 * i, 1000 * i + 500, i);
+}
+
+/** @brief RecordTogether records, then waits until `threads` threads have arrived so all of them are alive at once
+ */
+static void recordTogether(const char *thread_name, const int events, std::atomic<int> *arrived, const int threads)
+{
+    recordOn(thread_name, events);
+    arrived->fetch_add(1);
+    while (arrived->load() < threads) std::this_thread::yield();
+}
+
+static void testExitedThreadsBuffersAreReused()
+{
+    // One thread after the other: every one takes over the buffer of the one before
+    for (int t = 0; t < 50; t++)
+    {
+        std::thread worker(recordOn, t % 2 ? "odd" : "even", 3);
+        worker.join();
+    }
+    std::string trace = dumpTrace();
+    CHECK(occurrences(trace, "\"thread_name\"") == 1);
+    CHECK(occurrences(trace, "\"args\":{\"name\":\"odd\"}") == 1);    // the last owner
+    CHECK(occurrences(trace, "\"ph\":\"X\"") == 3);                    // and only its events
+
+    // Two threads alive at once need a buffer each, after which both are free again
+    std::atomic<int> pair(0);
+    std::thread a(recordTogether, "a", 2, &pair, 2), b(recordTogether, "b", 4, &pair, 2);
+    a.join();
+    b.join();
+    trace = dumpTrace();
+    CHECK(occurrences(trace, "\"thread_name\"") == 2);
+    CHECK(occurrences(trace, "\"ph\":\"X\"") == 6);
+
+    std::atomic<int> three(0);
+    std::thread c(recordTogether, "c", 1, &three, 3), d(recordTogether, "d", 1, &three, 3), e(recordTogether, "e", 1, &three, 3);
+    c.join();
+    d.join();
+    e.join();
+    CHECK(occurrences(dumpTrace(), "\"thread_name\"") == 3);
+}
+
+static void testDumpWhileLapping()
+{
+    // Every field of event i is derived from i, so an event torn between two writes shows as a mismatch
+    std::atomic<bool> done(false);
+    std::atomic<int64_t> recorded(0);
+    std::thread writer([&]()
+    {
+        TRACE_THREAD_NAME("lapper");
+        for (int64_t i = 0; !done.load(std::memory_order_relaxed); i++)
+        {
+            TraceRecorder::instance().complete("lap", i * 1000, i * 1000 + (i % 997) * 1000, i);
+            recorded.store(i + 1, std::memory_order_relaxed);
+        }
+    });
+    while (recorded.load() < (int64_t)TraceRecorder::EVENTS_PER_THREAD) std::this_thread::yield();
+
+    size_t events = 0;
+    bool consistent = true;
+    for (int d = 0; d < 5; d++)
+    {
+        std::istringstream trace(dumpTrace());
+        std::string line;
+        while (std::getline(trace, line))
+        {
+            if (line.find("\"name\":\"lap\"") == std::string::npos) continue;
+            double ts, dur;
+            long long frame;
+            const size_t at = line.find("\"ts\":");
+            if (at == std::string::npos
+                || sscanf(line.c_str() + at, "\"ts\":%lf,\"dur\":%lf,\"args\":{\"frame\":%lld}", &ts, &dur, &frame) != 3
+                || ts != (double)frame || dur != (double)(frame % 997))
+            {
+                consistent = false;
+            }
+            events++;
+        }
+    }
+    done = true;
+    writer.join();
+    CHECK(consistent);
+    CHECK(events > 0);
+}
+
+int main()
+{
+    testExitedThreadsBuffersAreReused();
+    testDumpWhileLapping();
+    return test::finish("trace_recorder_test");
+}
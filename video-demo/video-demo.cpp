@@ -2,43 +2,839 @@
 #include <memory>
 #include <chrono>
 #include <fstream>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <set>
+#include <queue>
+#include <functional>
+#include <climits>
+#include <cstdlib>
 
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/timer/timer.hpp>
 #include <boost/program_options.hpp>
+#include <boost/algorithm/string.hpp>
 
 #include "VideoDetector.h"
 #include "PhotoDetector.h"
+#include "FrameDetector.h"
 #include "AffdexException.h"
 
 #include "AFaceListener.hpp"
 #include "PlottingImageListener.hpp"
+#include "MetricsExporter.hpp"
+#include "ProcessStats.hpp"
+#include "TraceRecorder.hpp"
 #include "StatusListener.hpp"
+#include "PhotoPrefetcher.hpp"
+#include "FrameGrabber.hpp"
+#include "FrameCache.hpp"
+#include "PhotoResultCache.hpp"
 
 
 using namespace std;
 using namespace affdex;
 
-int main(int argsc, char ** argsv)
+static const std::set<boost::filesystem::path> VIDEO_EXTS  = { boost::filesystem::path(".avi"),
+                                                               boost::filesystem::path(".mov"),
+                                                               boost::filesystem::path(".flv"),
+                                                               boost::filesystem::path(".webm"),
+                                                               boost::filesystem::path(".wmv"),
+                                                               boost::filesystem::path(".mp4") };
+
+static const std::set<boost::filesystem::path> PHOTO_EXTS  = { boost::filesystem::path(".jpg"),
+                                                               boost::filesystem::path(".jpeg"),
+                                                               boost::filesystem::path(".png"),
+                                                               boost::filesystem::path(".bmp") };
+
+static const std::set<boost::filesystem::path> LIST_EXTS   = { boost::filesystem::path(".txt"),
+                                                               boost::filesystem::path(".lst") };
+
+static bool isVideo(const boost::filesystem::path &input)
+{
+    return VIDEO_EXTS.count(input.extension()) > 0;
+}
+
+/** @brief Settings shared by every detector the demo creates
+ */
+struct DetectorConfig
+{
+    affdex::path dataFolder;
+    int processFramerate;
+    unsigned int numFaces;
+    FaceDetectorMode faceMode;
+    boost::filesystem::path resultCache;    // photo result cache directory, empty when disabled
+};
+
+struct MetricsConfig
+{
+    int port;           // 0 when not served
+    std::string file;   // empty when not written
+    double interval;    // seconds between rewrites of file
+};
+
+/** @brief StartMetrics publishes the process metrics, and those of listener unless it is null, where config asks.
+ *  Declare metrics after listener so it stops before the listener goes away.
+ */
+static void startMetrics(MetricsExporter &metrics, const MetricsConfig &config, PlottingImageListener *listener)
+{
+    if (listener) metrics.addCollector([listener](PrometheusText &out) { listener->collectMetrics(out); });
+    metrics.addCollector(&ProcessStats::collect);
+    metrics.start((unsigned short)config.port, config.file, config.interval);
+}
+
+static void configureDetector(Detector &detector, const DetectorConfig &config, ImageListener *listener)
+{
+    detector.setClassifierPath(config.dataFolder);
+    detector.setDetectAllEmotions(true);
+    detector.setDetectAllExpressions(true);
+    detector.setDetectAllEmojis(true);
+    detector.setDetectAllAppearances(true);
+    detector.setImageListener(listener);
+}
+
+/** @brief MakeResultCache opens the photo result cache of the config, keyed on every setting that affects photo results
+ * @param max_photo_size -- Size photos are reduced to before detection, 0 for full size
+ * @return nullptr if the cache is disabled
+ */
+static std::unique_ptr<PhotoResultCache> makeResultCache(const DetectorConfig &config, const int max_photo_size)
+{
+    if (config.resultCache.empty()) return std::unique_ptr<PhotoResultCache>();
+    // configureDetector enables every classifier, the metric count stands for the classifier set
+    const std::string settings = "faceMode=" + std::to_string((int)config.faceMode)
+        + " numFaces=" + std::to_string(config.numFaces)
+        + " classifiers=all/" + std::to_string(metrics::METRIC_COUNT)
+        + " maxPhotoSize=" + std::to_string(max_photo_size);
+    return std::unique_ptr<PhotoResultCache>(new PhotoResultCache(config.resultCache, settings));
+}
+
+/** @brief MakeDetector creates and configures (but does not start) a detector for videos or for photos
+ */
+static std::shared_ptr<Detector> makeDetector(const DetectorConfig &config, const bool video, ImageListener *listener)
+{
+    std::shared_ptr<Detector> detector;
+    if (video)
+    {
+        detector = std::make_shared<VideoDetector>(config.processFramerate, config.numFaces, config.faceMode);
+    }
+    else
+    {
+        detector = std::make_shared<PhotoDetector>(config.numFaces, config.faceMode);
+    }
+    configureDetector(*detector, config, listener);
+    return detector;
+}
+
+static boost::filesystem::path outputPath(boost::filesystem::path input, const bool binary_output)
+{
+    return input.replace_extension(binary_output ? ".afxc" : ".csv");
+}
+
+/** @brief ProcessInput runs one file through an already started detector and drains its results into the listener
+ * @param cache   -- Photo result cache (from makeResultCache with full size photos), or nullptr
+ * @param verbose -- Print a line per result
+ */
+static void processInput(Detector &detector, PlottingImageListener &listener, const boost::filesystem::path &input,
+                         const PhotoResultCache *cache, const bool verbose)
+{
+    const bool is_video = isVideo(input);
+    uint64_t key = 0;
+    bool has_key = false;    // an empty or unreadable file has no content to key its results by
+    PlottingImageListener *listenPtr = &listener;
+    shared_ptr<StatusListener> videoListenPtr = std::make_shared<StatusListener>([listenPtr]() { listenPtr->wakeConsumer(); });
+    detector.setProcessStatusListener(videoListenPtr.get());
+    if (is_video)
+    {
+        static_cast<VideoDetector &>(detector).process(input.native()); //Process a video
+    }
+    else
+    {
+        std::ifstream in(input.string().c_str(), std::ios::binary);
+        const std::vector<uchar> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (cache && !data.empty())
+        {
+            key = cache->key(data);
+            has_key = true;
+            std::vector<FaceRecord> records;
+            if (cache->load(key, records))
+            {
+                listener.outputRecords(records, 0.0);    // a hit skips decoding and detection
+                return;
+            }
+        }
+        cv::Mat img = data.empty() ? cv::Mat() : cv::imdecode(data, CV_LOAD_IMAGE_COLOR);
+
+        // Create a frame
+        Frame frame(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR);
+
+        TRACE_SCOPE("sdk.process");
+        static_cast<PhotoDetector &>(detector).process(frame); //Process an image
+    }
+
+    PlottingImageListener::ResultLease result;
+    do
+    {
+        // Sleep until the detector hands over a result or reports that processing is over.
+        if (listener.waitForResult(std::chrono::milliseconds(500)) && listener.acquireResult(result))
+        {
+            listener.display(result.faces(), result.frame());    // Drawn on the render thread, if drawing or exporting
+
+            if (verbose)
+            {
+                std::cerr << "timestamp: " << result.frame().getTimestamp()
+                << " cfps: " << result.captureFPS
+                << " pfps: " << result.processFPS
+                << " faces: "<< result.faces().size() << endl;
+            }
+
+            listener.outputToFile(result.faces(), result.frame().getTimestamp());
+            if (has_key) cache->store(key, result.faces(), result.frame().getTimestamp());
+            result.release();   // Hand the slot back so the detector can refill it
+        }
+        listener.showLatest(!is_video);    // HighGUI stays on this (the main) thread; a photo is shown once drawn
+    } while (is_video && (videoListenPtr->isRunning() || listener.getDataSize() > 0));
+}
+
+// Frames kept queued in a FrameDetector, and how many 500ms waits without a result mean the rest was lost
+static const unsigned long long FRAME_BUFFER = 30;
+static const int FRAME_IDLE_LIMIT = 10;
+
+/** @brief FeedFrameDetector runs the frames of a FrameGrabber or FrameCache replay through a started FrameDetector,
+ *  passing every result to handle, and returns once all of them are answered
+ * @param time_offset -- Added to the video timestamps, the detector needs them to keep increasing across passes
+ * @return The number of frames that got no result (the listener's dropped results included)
+ */
+template <typename FrameSource>
+static unsigned long long feedFrameDetector(FrameSource &grabber, FrameDetector &detector, PlottingImageListener &listener,
+                                            const double time_offset,
+                                            const std::function<void(PlottingImageListener::ResultLease &)> &handle)
+{
+    unsigned long long submitted = 0, received = 0, lost = 0;
+    const unsigned long long dropped_before = listener.getDroppedCount();
+    PlottingImageListener::ResultLease result;
+
+    // Frames submitted but neither answered, dropped by the listener nor given up on. Clamped, the counters are read
+    // at different times.
+    auto inFlight = [&]() -> unsigned long long
+    {
+        const unsigned long long accounted = received + lost + (listener.getDroppedCount() - dropped_before);
+        return submitted > accounted ? submitted - accounted : 0;
+    };
+
+    auto collect = [&]()
+    {
+        while (listener.acquireResult(result))
+        {
+            received++;
+            // A result arriving after its frame was given up on is not lost after all
+            if (lost > 0 && received + lost + (listener.getDroppedCount() - dropped_before) > submitted) lost--;
+            handle(result);
+        }
+        result.release();
+    };
+
+    // Waits until at most limit frames are in the detector. Frames it never answers for are given up on.
+    auto settle = [&](const unsigned long long limit)
+    {
+        int idle = 0;
+        while (inFlight() > limit)
+        {
+            if (idle == FRAME_IDLE_LIMIT)
+            {
+                lost += inFlight();
+                break;
+            }
+            idle = listener.waitForResult(std::chrono::milliseconds(500)) ? 0 : idle + 1;
+            collect();
+        }
+    };
+
+    while (const FrameGrabber::GrabbedFrame *grabbed = grabber.acquire())
+    {
+        listener.throughput().captured();
+        settle(FRAME_BUFFER - 1);    // a full FrameDetector buffer would silently drop the frame
+        const cv::Mat &img = grabbed->image;
+        Frame frame(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR,
+                    (float)(grabbed->timestamp + time_offset));
+        {
+            TRACE_SCOPE("sdk.process");
+            detector.process(frame);
+        }
+        grabber.release();
+        submitted++;
+        collect();
+    }
+    settle(0);
+
+    listener.throughput().dropped(lost);    // the listener counts its own dropped results
+    return lost + listener.getDroppedCount() - dropped_before;
+}
+
+/** @brief ProcessGrabbed runs a video through a FrameDetector fed by a FrameGrabber, so the frames skipped to reach the
+ *  processing frame rate are never converted or copied. Loops over the video as long as loop is set.
+ * @param cache       -- Decode the video once into a FrameCache and replay every pass from it (soak runs)
+ * @param cache_bytes -- Byte budget of the cache, a video that needs more is decoded on every pass instead
+ * @param realtime    -- Replay the cache at the video's pace instead of as fast as the detector takes frames
+ */
+static void processGrabbed(const boost::filesystem::path &input, const DetectorConfig &config,
+                           PlottingImageListener &listener, const bool loop, const bool cache,
+                           const uint64_t cache_bytes, const bool realtime, const bool verbose)
+{
+    std::unique_ptr<FrameCache> frameCache;
+    if (cache)
+    {
+        try
+        {
+            frameCache.reset(new FrameCache(input.string(), config.processFramerate, cache_bytes));
+            std::cerr << "Cached " << frameCache->size() << " frames ("
+                      << frameCache->size() * frameCache->frameBytes() / (1024 * 1024) << " MB)" << std::endl;
+        }
+        catch (FrameCache::BudgetExceeded &ex)
+        {
+            std::cerr << ex.what() << ", decoding it on every pass instead" << std::endl;
+        }
+    }
+
+    FrameDetector detector((int)FRAME_BUFFER, config.processFramerate, config.numFaces, config.faceMode);
+    configureDetector(detector, config, &listener);
+    detector.start();
+
+    double time_offset = 0.0, last_ts = 0.0;
+    unsigned long long grabbed = 0, retrieved = 0, lost = 0;
+    auto handle = [&](PlottingImageListener::ResultLease &result)
+    {
+        listener.display(result.faces(), result.frame());
+        listener.showLatest();
+        if (verbose)
+        {
+            std::cerr << "timestamp: " << result.frame().getTimestamp()
+            << " cfps: " << result.captureFPS
+            << " pfps: " << result.processFPS
+            << " faces: " << result.faces().size() << endl;
+        }
+        listener.outputToFile(result.faces(), result.frame().getTimestamp());
+        last_ts = result.frame().getTimestamp();
+    };
+
+    do
+    {
+        if (frameCache)
+        {
+            frameCache->rewind(realtime);
+            lost += feedFrameDetector(*frameCache, detector, listener, time_offset, handle);
+            time_offset = last_ts + 1.0 / frameCache->getFps();
+        }
+        else
+        {
+            FrameGrabber grabber(input.string(), config.processFramerate);
+            lost += feedFrameDetector(grabber, detector, listener, time_offset, handle);
+            grabbed += grabber.getGrabbedCount();
+            retrieved += grabber.getRetrievedCount();
+            time_offset = last_ts + 1.0 / grabber.getFps();
+        }
+    } while (loop);
+
+    detector.stop();
+    if (!frameCache) std::cerr << "Frames decoded: " << grabbed << ", retrieved for processing: " << retrieved << std::endl;
+    if (lost > 0) std::cerr << "Warning: " << lost << " frames got no result" << std::endl;
+}
+
+/** @brief Frames of one time shard: decoding starts at firstFrame, rows are kept from startFrame to endFrame (excluded).
+ *  The frames before startFrame only warm up the face tracker.
+ */
+struct ShardRange
+{
+    int firstFrame;
+    int startFrame;
+    int endFrame;
+};
+
+/** @brief ProcessShard decodes one time range of the video and runs it through its own FrameDetector,
+ *  writing the rows of the range (overlap trimmed) to shardPath
+ */
+static void processShard(const boost::filesystem::path &input, const ShardRange &range, const double fps,
+                         const DetectorConfig &config, const boost::filesystem::path &shardPath,
+                         std::mutex &log_mutex, std::atomic<unsigned int> &failures)
+{
+    try
+    {
+        FrameGrabber grabber(input.string(), config.processFramerate, range.firstFrame, range.endFrame);
+
+        std::ofstream out(shardPath.c_str());
+        if (!out.is_open()) throw std::runtime_error("unable to open " + shardPath.string());
+
+        PlottingImageListener listener(out, false);
+        FrameDetector detector((int)FRAME_BUFFER, config.processFramerate, config.numFaces, config.faceMode);
+        configureDetector(detector, config, &listener);
+        detector.start();
+
+        const float start_ts = (float)(range.startFrame / fps);    // same rounding as the frame timestamps
+        const unsigned long long lost = feedFrameDetector(grabber, detector, listener, 0.0,
+            [&](PlottingImageListener::ResultLease &result)
+            {
+                if (result.frame().getTimestamp() >= start_ts)
+                {
+                    listener.outputToFile(result.faces(), result.frame().getTimestamp());
+                }
+            });
+
+        detector.stop();
+        listener.closeOutput();
+
+        if (lost > 0)
+        {
+            std::lock_guard<std::mutex> lg(log_mutex);
+            std::cerr << "Warning: " << lost << " frames of shard " << shardPath << " got no result" << std::endl;
+        }
+    }
+    catch (std::exception &ex)
+    {
+        std::lock_guard<std::mutex> lg(log_mutex);
+        std::cerr << "Failed to process shard " << shardPath << ": " << ex.what() << std::endl;
+        failures++;
+    }
+}
+
+/** @brief MergeShards k-way merges timestamp-ordered shard CSVs into one CSV with a single header
+ */
+static void mergeShards(const std::vector<boost::filesystem::path> &shardPaths, const boost::filesystem::path &outPath)
+{
+    std::ofstream out(outPath.c_str());
+    if (!out.is_open()) throw std::runtime_error("Unable to open output file " + outPath.string());
+
+    std::vector<std::unique_ptr<std::ifstream> > shards;
+    std::vector<std::string> lines(shardPaths.size());
+    std::string header;
+
+    // Ordered by (timestamp, shard), each shard has at most one line in the queue so its own order is kept
+    typedef std::pair<double, size_t> Head;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head> > heads;
+
+    for (size_t k = 0; k < shardPaths.size(); k++)
+    {
+        shards.push_back(std::unique_ptr<std::ifstream>(new std::ifstream(shardPaths[k].c_str())));
+        std::getline(*shards[k], header);
+        if (std::getline(*shards[k], lines[k])) heads.push(Head(strtod(lines[k].c_str(), nullptr), k));
+    }
+    out << header << std::endl;
+
+    while (!heads.empty())
+    {
+        const size_t k = heads.top().second;
+        heads.pop();
+        out << lines[k] << '\n';
+        if (std::getline(*shards[k], lines[k])) heads.push(Head(strtod(lines[k].c_str(), nullptr), k));
+    }
+}
+
+/** @brief RunSharded splits one video into time ranges processed in parallel, then merges them into one CSV
+ * @return The number of shards that failed
+ */
+static unsigned int runSharded(const boost::filesystem::path &input, unsigned int shards, const double overlap,
+                               const DetectorConfig &config)
+{
+    double fps, frame_count;
+    {
+        cv::VideoCapture video(input.string());
+        if (!video.isOpened()) throw std::runtime_error("Unable to open video " + input.string());
+        fps = video.get(CV_CAP_PROP_FPS);
+        frame_count = video.get(CV_CAP_PROP_FRAME_COUNT);
+    }
+    if (fps <= 0 || frame_count <= 0) throw std::runtime_error("Unable to read the frame rate and length of " + input.string());
+
+    const int frames_per_shard = (int)(frame_count / shards) + 1;
+    const int overlap_frames = (int)(overlap * fps);
+
+    std::vector<ShardRange> ranges;
+    std::vector<boost::filesystem::path> shardPaths;
+    for (unsigned int k = 0; k < shards; k++)
+    {
+        ShardRange range;
+        range.startFrame = k * frames_per_shard;
+        range.firstFrame = (std::max)(range.startFrame - overlap_frames, 0);
+        range.endFrame = k + 1 == shards ? INT_MAX : (k + 1) * frames_per_shard;    // frame counts are estimates, run the last one to the end
+        ranges.push_back(range);
+
+        boost::filesystem::path shardPath(input);
+        shardPath.replace_extension(".shard" + std::to_string(k) + ".csv");
+        shardPaths.push_back(shardPath);
+    }
+    std::cout << "Processing " << input << " in " << shards << " shards of " << frames_per_shard / fps << "s" << std::endl;
+
+    std::atomic<unsigned int> failures(0);
+    std::mutex log_mutex;
+    std::vector<std::thread> threads;
+    for (unsigned int k = 0; k < shards; k++)
+    {
+        threads.push_back(std::thread(processShard, std::cref(input), std::cref(ranges[k]), fps, std::cref(config),
+                                      std::cref(shardPaths[k]), std::ref(log_mutex), std::ref(failures)));
+    }
+    for (std::thread &t : threads) t.join();
+
+    const boost::filesystem::path csvPath = outputPath(input, false);
+    if (failures == 0)
+    {
+        mergeShards(shardPaths, csvPath);
+        for (const boost::filesystem::path &shardPath : shardPaths) boost::filesystem::remove(shardPath);
+        std::cout << "Output written to file: " << csvPath << std::endl;
+    }
+    return failures;
+}
+
+// Sample points closer than this (in seconds) are reached by grabbing forward, farther ones by seeking.
+// Seeking decodes from the previous keyframe anyway, so it only pays off past a typical keyframe interval.
+static const double SURVEY_SEEK_DISTANCE = 2.0;
+
+/** @brief RunSurvey analyzes one frame every interval seconds of the video, each as a still photo, and writes them
+ *  in the same format as a full pass. The cost grows with the number of samples, not with the length of the video.
+ * @return The number of samples that could not be decoded
+ */
+static unsigned int runSurvey(const boost::filesystem::path &input, const double interval, const DetectorConfig &config,
+                              const bool binary_output, const MetricsConfig &metrics_config)
+{
+    cv::VideoCapture video(input.string());
+    if (!video.isOpened()) throw std::runtime_error("Unable to open video " + input.string());
+    const double fps = video.get(CV_CAP_PROP_FPS);
+    const double frame_count = video.get(CV_CAP_PROP_FRAME_COUNT);
+    if (fps <= 0 || frame_count <= 0) throw std::runtime_error("Unable to read the frame rate and length of " + input.string());
+
+    const boost::filesystem::path outPath = outputPath(input, binary_output);
+    std::ofstream out(outPath.c_str(), binary_output ? std::ios::out | std::ios::binary : std::ios::out);
+    if (!out.is_open()) throw std::runtime_error("Unable to open output file " + outPath.string());
+
+    PlottingImageListener listener(out, false,
+        binary_output ? PlottingImageListener::OutputFormat::COLUMNAR : PlottingImageListener::OutputFormat::CSV);
+    MetricsExporter metrics;
+    startMetrics(metrics, metrics_config, &listener);
+    std::shared_ptr<Detector> detector = makeDetector(config, false, &listener);
+    detector->start();
+
+    const int samples = (int)(frame_count / fps / interval) + 1;
+    const int seek_distance = (int)(SURVEY_SEEK_DISTANCE * fps);
+    std::cout << "Surveying " << input << ": " << samples << " samples, one every " << interval << "s" << std::endl;
+
+    unsigned int failures = 0;
+    int position = 0;    // index of the frame the next read() returns
+    PlottingImageListener::ResultLease result;
+    cv::Mat img;
+    for (int k = 0; k < samples; k++)
+    {
+        const int target = (int)(k * interval * fps + 0.5);
+        if (target >= frame_count) break;
+
+        if (target < position || target - position > seek_distance)
+        {
+            video.set(CV_CAP_PROP_POS_FRAMES, target);
+            position = target;
+        }
+        while (position < target && video.grab()) position++;
+        if (position < target || !video.read(img))
+        {
+            failures++;
+            position = INT_MAX;    // force a seek for the next sample
+            continue;
+        }
+        position++;
+
+        Frame frame(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR, (float)(target / fps));
+        static_cast<PhotoDetector &>(*detector).process(frame);
+
+        if (listener.waitForResult(std::chrono::milliseconds(500)) && listener.acquireResult(result))
+        {
+            listener.outputToFile(result.faces(), result.frame().getTimestamp());
+            result.release();
+        }
+    }
+
+    detector->stop();
+    metrics.stop();
+    listener.closeOutput();
+    if (failures > 0) std::cerr << "Warning: " << failures << " samples could not be decoded" << std::endl;
+    std::cout << "Output written to file: " << outPath << std::endl;
+    return failures;
+}
+
+static bool hasWildcard(const boost::filesystem::path &input)
+{
+    return input.filename().string().find_first_of("*?") != std::string::npos;
+}
+
+/** @brief WildcardMatch matches name against a pattern where * is any run of characters and ? any single one
+ */
+static bool wildcardMatch(const char *pattern, const char *name)
+{
+    if (*pattern == '\0') return *name == '\0';
+    if (*pattern == '*') return wildcardMatch(pattern + 1, name) || (*name != '\0' && wildcardMatch(pattern, name + 1));
+    return *name != '\0' && (*pattern == '?' || *pattern == *name) && wildcardMatch(pattern + 1, name + 1);
+}
+
+/** @brief CollectInputs expands a directory (its video and photo files), a file name pattern with * or ? wildcards
+ *  or a list file (one path per line)
+ */
+static std::vector<boost::filesystem::path> collectInputs(const boost::filesystem::path &input)
+{
+    std::vector<boost::filesystem::path> inputs;
+    if (boost::filesystem::is_directory(input) || hasWildcard(input))
+    {
+        const bool glob = hasWildcard(input);
+        const std::string pattern = input.filename().string();
+        const boost::filesystem::path folder = !glob ? input
+            : input.has_parent_path() ? input.parent_path() : boost::filesystem::path(".");
+        for (boost::filesystem::directory_iterator it(folder), end; it != end; ++it)
+        {
+            const boost::filesystem::path ext = it->path().extension();
+            const bool wanted = glob ? wildcardMatch(pattern.c_str(), it->path().filename().string().c_str())
+                                     : VIDEO_EXTS.count(ext) || PHOTO_EXTS.count(ext);
+            if (boost::filesystem::is_regular_file(it->status()) && wanted)
+            {
+                inputs.push_back(it->path());
+            }
+        }
+        std::sort(inputs.begin(), inputs.end());
+    }
+    else
+    {
+        std::ifstream list(input.string().c_str());
+        std::string line;
+        while (std::getline(list, line))
+        {
+            boost::algorithm::trim(line);
+            if (!line.empty()) inputs.push_back(boost::filesystem::path(line));
+        }
+    }
+    return inputs;
+}
+
+// Photos waiting for the detector per decode thread
+static const size_t PHOTO_PREFETCH_PER_THREAD = 2;
+
+/** @brief CombinedOutputPath names the single output of a photo batch after its directory, list file or glob folder
+ */
+static boost::filesystem::path combinedOutputPath(boost::filesystem::path input, const bool binary_output)
+{
+    if (hasWildcard(input)) input = input.has_parent_path() ? input.parent_path() : boost::filesystem::path("photos");
+    if (input.filename() == ".") input = input.parent_path();
+    return outputPath(input, binary_output);
+}
+
+/** @brief RunPhotoBatch runs every photo through one PhotoDetector while a pool of threads decodes the next ones.
+ *  All rows go to one output file, the timestamp column holding the photo's index in the list written next to it.
+ * @return The number of photos that could not be read
+ */
+static unsigned int runPhotoBatch(const std::vector<boost::filesystem::path> &photos, const boost::filesystem::path &outPath,
+                                  const DetectorConfig &config, const bool binary_output, const int max_photo_size,
+                                  const MetricsConfig &metrics_config)
+{
+    std::ofstream out(outPath.c_str(), binary_output ? std::ios::out | std::ios::binary : std::ios::out);
+    if (!out.is_open()) throw std::runtime_error("Unable to open output file " + outPath.string());
+
+    boost::filesystem::path listPath(outPath);
+    listPath.replace_extension(".files.txt");
+    std::ofstream list(listPath.c_str());
+    for (const boost::filesystem::path &photo : photos) list << photo.string() << '\n';
+
+    PlottingImageListener listener(out, false,
+        binary_output ? PlottingImageListener::OutputFormat::COLUMNAR : PlottingImageListener::OutputFormat::CSV);
+    MetricsExporter metrics;
+    startMetrics(metrics, metrics_config, &listener);
+    std::shared_ptr<Detector> detector = makeDetector(config, false, &listener);
+    detector->start();
+
+    // The detector keeps one core busy, the others decode
+    const unsigned int decoders = (std::max)(std::thread::hardware_concurrency(), 2u) - 1;
+    std::cout << "Processing " << photos.size() << " photos with " << decoders << " decode threads" << std::endl;
+
+    const std::unique_ptr<PhotoResultCache> cache = makeResultCache(config, max_photo_size);
+    unsigned int failures = 0;
+    size_t hits = 0;
+    {
+        PhotoPrefetcher prefetcher(photos, decoders, decoders * PHOTO_PREFETCH_PER_THREAD, max_photo_size, cache.get());
+        PlottingImageListener::ResultLease result;
+        size_t index;
+        PhotoPrefetcher::Photo photo;
+        while (prefetcher.next(index, photo))
+        {
+            if (photo.cached)
+            {
+                listener.outputRecords(photo.records, (double)index);
+                hits++;
+                continue;
+            }
+            const cv::Mat &img = photo.image;
+            if (img.empty())
+            {
+                std::cerr << "Unable to read " << photos[index] << std::endl;
+                failures++;
+                continue;
+            }
+
+            Frame frame(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR, (float)index);
+            static_cast<PhotoDetector &>(*detector).process(frame);
+
+            if (listener.waitForResult(std::chrono::milliseconds(500)) && listener.acquireResult(result))
+            {
+                listener.outputToFile(result.faces(), result.frame().getTimestamp());
+                if (cache) cache->store(photo.key, result.faces(), result.frame().getTimestamp());
+                result.release();
+            }
+        }
+    }
+
+    detector->stop();
+    metrics.stop();
+    listener.closeOutput();
+    if (cache) std::cout << hits << " of " << photos.size() << " photos came from the result cache" << std::endl;
+    std::cout << "Output written to file: " << outPath << " (photo list in " << listPath << ")" << std::endl;
+    return failures;
+}
+
+/** @brief BatchWorker owns one listener and a video and/or photo detector, each started once, and processes
+ *  files from the shared queue until it is empty. Every file gets its own output file.
+ */
+static void batchWorker(const std::vector<boost::filesystem::path> &inputs, std::atomic<size_t> &next,
+                        const DetectorConfig &config, const bool binary_output,
+                        std::mutex &log_mutex, std::atomic<unsigned int> &failures)
+{
+    std::unique_ptr<std::ofstream> out;
+    std::unique_ptr<PlottingImageListener> listener;
+    std::shared_ptr<Detector> videoDetector, photoDetector;
+    const std::unique_ptr<PhotoResultCache> cache = makeResultCache(config, 0);
+
+    for (size_t i = next++; i < inputs.size(); i = next++)
+    {
+        const boost::filesystem::path &input = inputs[i];
+        const boost::filesystem::path csvPath = outputPath(input, binary_output);
+        std::unique_ptr<std::ofstream> fileOut(new std::ofstream(csvPath.c_str(),
+            binary_output ? std::ios::out | std::ios::binary : std::ios::out));
+        if (!fileOut->is_open())
+        {
+            std::lock_guard<std::mutex> lg(log_mutex);
+            std::cerr << "Unable to open output file " << csvPath << std::endl;
+            failures++;
+            continue;
+        }
+
+        // The previous file's stream is closed once the writer has moved on to the new one
+        if (!listener)
+        {
+            listener.reset(new PlottingImageListener(*fileOut, false,
+                binary_output ? PlottingImageListener::OutputFormat::COLUMNAR : PlottingImageListener::OutputFormat::CSV));
+        }
+        else
+        {
+            listener->retargetOutput(*fileOut);
+        }
+        out.swap(fileOut);
+
+        try
+        {
+            const bool is_video = isVideo(input);
+            std::shared_ptr<Detector> &detector = is_video ? videoDetector : photoDetector;
+            if (!detector)
+            {
+                detector = makeDetector(config, is_video, listener.get());
+                detector->start();
+            }
+
+            processInput(*detector, *listener, input, cache.get(), false);
+            listener->flushOutput();
+
+            std::lock_guard<std::mutex> lg(log_mutex);
+            std::cout << "Output written to file: " << csvPath << std::endl;
+        }
+        catch (std::exception &ex)
+        {
+            std::lock_guard<std::mutex> lg(log_mutex);
+            std::cerr << "Failed to process " << input << ": " << ex.what() << std::endl;
+            failures++;
+        }
+    }
+
+    if (videoDetector) videoDetector->stop();
+    if (photoDetector) photoDetector->stop();
+    if (listener) listener->closeOutput();
+}
+
+/** @brief RunBatch processes many files on a pool of warm detectors, largest files first
+ * @return The number of files that could not be processed
+ */
+static unsigned int runBatch(std::vector<boost::filesystem::path> inputs, unsigned int workers,
+                             const DetectorConfig &config, const bool binary_output)
 {
+    // Handing out the largest files first keeps one long clip from running alone at the end
+    std::vector<std::pair<boost::uintmax_t, boost::filesystem::path> > sized;
+    for (const boost::filesystem::path &input : inputs)
+    {
+        boost::system::error_code ec;
+        const boost::uintmax_t size = boost::filesystem::file_size(input, ec);
+        sized.push_back(std::make_pair(ec ? 0 : size, input));
+    }
+    std::sort(sized.begin(), sized.end(),
+              [](const std::pair<boost::uintmax_t, boost::filesystem::path> &a,
+                 const std::pair<boost::uintmax_t, boost::filesystem::path> &b) { return a.first > b.first; });
+    inputs.clear();
+    for (const auto &entry : sized) inputs.push_back(entry.second);
 
+    if (workers == 0) workers = (std::max)(std::thread::hardware_concurrency(), 1u);
+    workers = (std::min)(workers, (unsigned int)inputs.size());
+    std::cout << "Processing " << inputs.size() << " files with " << workers << " detectors" << std::endl;
 
+    std::atomic<size_t> next(0);
+    std::atomic<unsigned int> failures(0);
+    std::mutex log_mutex;
+    std::vector<std::thread> threads;
+    for (unsigned int w = 0; w < workers; w++)
+    {
+        threads.push_back(std::thread(batchWorker, std::cref(inputs), std::ref(next), std::cref(config), binary_output,
+                                      std::ref(log_mutex), std::ref(failures)));
+    }
+    for (std::thread &t : threads) t.join();
+    return failures;
+}
 
-    std::map<boost::filesystem::path, bool> VIDEO_EXTS  = { {boost::filesystem::path(".avi"), 1},
-                                                            {boost::filesystem::path(".mov"), 1},
-                                                            {boost::filesystem::path(".flv"), 1},
-                                                            {boost::filesystem::path(".webm"), 1},
-                                                            {boost::filesystem::path(".wmv"), 1},
-                                                            {boost::filesystem::path(".mp4"), 1} };
+/** @brief RejectPlaybackOptions reports the first option of the single video run that a batch, survey or sharded run
+ *  (named by mode) was given: those runs never display, export or loop, and decode on their own
+ * @return Whether there was any, the caller then exits
+ */
+static bool rejectPlaybackOptions(const char *mode, const bool draw, const std::string &export_path, const bool loop,
+                                  const bool grab)
+{
+    const char *option = draw ? "--draw" : !export_path.empty() ? "--export" : loop ? "--loop" : grab ? "--grab" : nullptr;
+    if (option == nullptr) return false;
+    std::cerr << mode << " does not support " << option << ", drop it" << std::endl;
+    return true;
+}
+
+int main(int argsc, char ** argsv)
+{
     affdex::path DATA_FOLDER;
     affdex::path videoPath;
 
     int process_framerate = 30;
     bool draw_display = true;
     bool loop = false;
+    bool binary_output = false;
+    std::string export_path;
     unsigned int nFaces = 1;
+    unsigned int workers = 0;
+    unsigned int shards = 1;
+    double shard_overlap = 2.0;
+    double survey_interval = 0.0;
+    bool photo_batch = false;
+    int max_photo_size = 1280;
+    bool grab = false;
+    bool loop_cache = false;
+    bool loop_realtime = false;
+    unsigned int loop_cache_mb = 4096;
+    std::string result_cache;
+    int metrics_port = 0;
+    std::string metrics_file;
+    double metrics_interval = 10.0;
+    std::string trace_path;
     int faceDetectorMode = (int)FaceDetectorMode::LARGE_FACES;
 
     const int precision = 2;
@@ -51,16 +847,37 @@ int main(int argsc, char ** argsv)
     ("help,h", po::bool_switch()->default_value(false), "Display this help message.")
 #ifdef _WIN32
     ("data,d", po::wvalue< affdex::path >(&DATA_FOLDER)->default_value(affdex::path(L"data"), std::string("data")), "Path to the data folder")
-    ("input,i", po::wvalue< affdex::path >(&videoPath)->required(), "Video file to processs")
+    ("input,i", po::wvalue< affdex::path >(&videoPath)->required(), "Video file to processs, or a directory or list file (.txt, one path per line) to process in batch")
 #else // _WIN32
     ("data,d", po::value< affdex::path >(&DATA_FOLDER)->default_value(affdex::path("data"), std::string("data")), "Path to the data folder")
-    ("input,i", po::value< affdex::path >(&videoPath)->required(), "Video file to processs")
+    ("input,i", po::value< affdex::path >(&videoPath)->required(), "Video file to processs, or a directory or list file (.txt, one path per line) to process in batch")
 #endif // _WIN32
     ("pfps", po::value< int >(&process_framerate)->default_value(30), "Processing framerate.")
     ("draw", po::value< bool >(&draw_display)->default_value(true), "Draw video on screen.")
     ("faceMode", po::value< int >(&faceDetectorMode)->default_value((int)FaceDetectorMode::SMALL_FACES), "Face detector mode (large faces vs small faces).")
     ("numFaces", po::value< unsigned int >(&nFaces)->default_value(1), "Number of faces to be tracked.")
     ("loop", po::value< bool >(&loop)->default_value(false), "Loop over the video being processed.")
+    ("binary", po::value< bool >(&binary_output)->default_value(false), "Write the metrics in the binary columnar format (.afxc) instead of CSV.")
+    ("export", po::value< std::string >(&export_path), "Also write the annotated video to this file (.avi), works with --draw false.")
+    ("workers", po::value< unsigned int >(&workers)->default_value(0), "Detectors running in parallel in batch mode (0: one per core).")
+    ("shards", po::value< unsigned int >(&shards)->default_value(1), "Split a video into this many time ranges processed in parallel, then merged into one CSV. Face ids restart in every shard.")
+    ("overlap", po::value< double >(&shard_overlap)->default_value(2.0), "Seconds of video each shard processes before its range to warm up the face tracker.")
+    ("survey", po::value< double >(&survey_interval)->default_value(0.0), "Only analyze one frame every this many seconds, seeking between them, for a coarse timeline of long videos (0: every frame).")
+    ("photoBatch", po::value< bool >(&photo_batch)->default_value(false), "Process the photos of a directory, list file or glob through one detector, with parallel decoding, into a single output file.")
+    ("grab", po::value< bool >(&grab)->default_value(false), "Decode the video on an own thread feeding a FrameDetector, frames skipped to reach --pfps are never converted.")
+    ("loopCache", po::value< bool >(&loop_cache)->default_value(false), "Decode the video once into a memory-mapped frame cache (in the temp directory) and replay every --loop pass from it.")
+    ("loopCacheMB", po::value< unsigned int >(&loop_cache_mb)->default_value(4096), "Most megabytes of decoded frames the --loopCache may hold, a longer video is decoded on every pass instead (0: no limit).")
+    ("loopRealtime", po::value< bool >(&loop_realtime)->default_value(false), "Replay the frame cache at the video's frame rate instead of at full speed.")
+    ("resultCache", po::value< std::string >(&result_cache), "Directory caching photo results by content and detector settings, unchanged photos skip decoding and detection.")
+    ("maxPhotoSize", po::value< int >(&max_photo_size)->default_value(1280), "In photo batches, photos at least twice this size are decoded at a reduced size (0: never).")
+    ("metricsPort", po::value< int >(&metrics_port)->default_value(0), "Serve Prometheus metrics at http://127.0.0.1:<port>/metrics while processing (0: off). Batch and sharded runs only report process metrics.")
+    ("metricsFile", po::value< std::string >(&metrics_file), "Also write the Prometheus metrics to this file, and only there if the port cannot be bound.")
+    ("metricsInterval", po::value< double >(&metrics_interval)->default_value(10.0), "Seconds between rewrites of --metricsFile.")
+#ifdef _WIN32
+    ("trace", po::value< std::string >(&trace_path), "Record a timeline of the pipeline stages and write it to this file (Chrome trace JSON, open in ui.perfetto.dev) on exit and on Ctrl+Break.")
+#else // _WIN32
+    ("trace", po::value< std::string >(&trace_path), "Record a timeline of the pipeline stages and write it to this file (Chrome trace JSON, open in ui.perfetto.dev) on exit and on SIGUSR1.")
+#endif // _WIN32
     ;
     po::variables_map args;
     try
@@ -88,115 +905,227 @@ int main(int argsc, char ** argsv)
         std::cerr << description << std::endl;
         return 1;
     }
-    try
+    if (metrics_port < 0 || metrics_port > 65535)
+    {
+        std::cerr << "The metrics port must be between 0 and 65535." << std::endl;
+        return 1;
+    }
+    if (survey_interval > 0 && shards > 1)
     {
-        std::shared_ptr<Detector> detector;
+        std::cerr << "A survey samples the whole video on its own, drop either --survey or --shards" << std::endl;
+        return 1;
+    }
+    // --draw is on by default, only asking for it explicitly conflicts with the runs that never display
+    const bool draw_requested = draw_display && !args["draw"].defaulted();
+    TRACE_THREAD_NAME("main");
+    std::unique_ptr<TraceSession> trace;
+    if (!trace_path.empty())
+    {
+        trace.reset(new TraceSession(trace_path));
+    }
 
-        //Initialize out file
-        boost::filesystem::path csvPath(videoPath);
-        boost::filesystem::path fileExt = csvPath.extension();
-        csvPath.replace_extension(".csv");
-        std::ofstream csvFileStream(csvPath.c_str());
+    DetectorConfig config;
+    config.dataFolder = DATA_FOLDER;
+    config.processFramerate = process_framerate;
+    config.numFaces = nFaces;
+    config.faceMode = (affdex::FaceDetectorMode) faceDetectorMode;
+    config.resultCache = result_cache;
 
-        if (!csvFileStream.is_open())
+    MetricsConfig metrics_config;
+    metrics_config.port = metrics_port;
+    metrics_config.file = metrics_file;
+    metrics_config.interval = metrics_interval;
+
+    // A directory or list file is processed in batch, without display, on a pool of detectors
+    const boost::filesystem::path inputPath(videoPath);
+    if (boost::filesystem::is_directory(inputPath) || hasWildcard(inputPath) || LIST_EXTS.count(inputPath.extension()))
+    {
+        if (shards > 1 || survey_interval > 0)
         {
-            std::cerr << "Unable to open csv file " << csvPath << std::endl;
+            std::cerr << "Batch processing runs every file whole, drop --shards and --survey" << std::endl;
             return 1;
         }
-
-        if (VIDEO_EXTS[fileExt]) // IF it is a video file.
+        if (rejectPlaybackOptions("Batch processing", draw_requested, export_path, loop, grab))
         {
-            detector = std::make_shared<VideoDetector>(process_framerate, nFaces, (affdex::FaceDetectorMode) faceDetectorMode);
+            return 1;
         }
-        else //Otherwise it's a photo
+        std::vector<boost::filesystem::path> inputs = collectInputs(inputPath);
+        if (photo_batch)
         {
-            detector = std::make_shared<PhotoDetector>(nFaces, (affdex::FaceDetectorMode) faceDetectorMode);
+            inputs.erase(std::remove_if(inputs.begin(), inputs.end(),
+                                        [](const boost::filesystem::path &p) { return isVideo(p); }), inputs.end());
         }
+        if (inputs.empty())
+        {
+            std::cerr << "No input files found in " << inputPath << std::endl;
+            return 1;
+        }
+        if (photo_batch)
+        {
+            try
+            {
+                return runPhotoBatch(inputs, combinedOutputPath(inputPath, binary_output), config, binary_output, max_photo_size,
+                                     metrics_config) == 0 ? 0 : 1;
+            }
+            catch (std::exception &ex)
+            {
+                std::cerr << ex.what() << std::endl;
+                return 1;
+            }
+        }
+        try
+        {
+            // Each worker's listener only lives for one file, so a batch publishes the process metrics alone
+            MetricsExporter metrics;
+            startMetrics(metrics, metrics_config, nullptr);
+            return runBatch(inputs, workers, config, binary_output) == 0 ? 0 : 1;
+        }
+        catch (std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+    }
 
+    if (survey_interval > 0)
+    {
+        if (!isVideo(inputPath))
+        {
+            std::cerr << "Only a video can be surveyed, drop --survey" << std::endl;
+            return 1;
+        }
+        if (rejectPlaybackOptions("A survey", draw_requested, export_path, loop, grab))
+        {
+            return 1;
+        }
+        try
+        {
+            return runSurvey(inputPath, survey_interval, config, binary_output, metrics_config) == 0 ? 0 : 1;
+        }
+        catch (std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+    }
 
-        //VideoDetector videoDetector(process_framerate, nFaces, (affdex::FaceDetectorMode) faceDetectorMode);
-
-
-
-        std::cout << "Max num of faces set to: " << detector->getMaxNumberFaces() << std::endl;
-        std::string mode;
-        switch (detector->getFaceDetectorMode())
+    if (shards > 1)
+    {
+        if (!isVideo(inputPath))
         {
-            case FaceDetectorMode::LARGE_FACES:
-                mode = "LARGE_FACES";
-                break;
-            case FaceDetectorMode::SMALL_FACES:
-                mode = "SMALL_FACES";
-                break;
-            default:
-                break;
+            std::cerr << "Only a video can be split into shards, drop --shards" << std::endl;
+            return 1;
         }
+        if (rejectPlaybackOptions("Sharded processing", draw_requested, export_path, loop, grab))
+        {
+            return 1;
+        }
+        if (binary_output)
+        {
+            std::cerr << "Sharded processing only writes CSV, drop --binary" << std::endl;
+            return 1;
+        }
+        try
+        {
+            // Shards run a listener each, only the process metrics cover them all
+            MetricsExporter metrics;
+            startMetrics(metrics, metrics_config, nullptr);
+            return runSharded(inputPath, shards, shard_overlap, config) == 0 ? 0 : 1;
+        }
+        catch (std::exception &ex)
+        {
+            std::cerr << ex.what() << std::endl;
+            return 1;
+        }
+    }
 
-        std::cout << "Face detector mode set to: " << mode << std::endl;
-        shared_ptr<PlottingImageListener> listenPtr(new PlottingImageListener(csvFileStream, draw_display));
+    try
+    {
+        //Initialize out file
+        boost::filesystem::path csvPath = outputPath(inputPath, binary_output);
+        std::ofstream csvFileStream(csvPath.c_str(), binary_output ? std::ios::out | std::ios::binary : std::ios::out);
 
-        detector->setClassifierPath(DATA_FOLDER);
-        detector->setDetectAllEmotions(true);
-        detector->setDetectAllExpressions(true);
-        detector->setDetectAllEmojis(true);
-        detector->setDetectAllAppearances(true);
-        detector->setImageListener(listenPtr.get());
+        if (!csvFileStream.is_open())
+        {
+            std::cerr << "Unable to open output file " << csvPath << std::endl;
+            return 1;
+        }
 
+        shared_ptr<PlottingImageListener> listenPtr(new PlottingImageListener(csvFileStream, draw_display,
+            binary_output ? PlottingImageListener::OutputFormat::COLUMNAR : PlottingImageListener::OutputFormat::CSV));
+        if (!export_path.empty())
+        {
+            listenPtr->exportVideo(export_path, process_framerate);
+        }
 
-        detector->start();    //Initialize the detectors .. call only once
+        MetricsExporter metrics;
+        startMetrics(metrics, metrics_config, listenPtr.get());
 
-        do
+        if ((grab || loop_cache) && isVideo(inputPath))
         {
-            shared_ptr<StatusListener> videoListenPtr = std::make_shared<StatusListener>();
-            detector->setProcessStatusListener(videoListenPtr.get());
-            if (VIDEO_EXTS[fileExt])
+            processGrabbed(inputPath, config, *listenPtr, loop, loop_cache, (uint64_t)loop_cache_mb * 1024 * 1024,
+                           loop_realtime, true);
+        }
+        else
+        {
+            // A video detector if it is a video file, otherwise it's a photo
+            std::shared_ptr<Detector> detector = makeDetector(config, isVideo(inputPath), listenPtr.get());
+
+            std::cout << "Max num of faces set to: " << detector->getMaxNumberFaces() << std::endl;
+            std::string mode;
+            switch (detector->getFaceDetectorMode())
             {
-                ((VideoDetector *)detector.get())->process(videoPath); //Process a video
+                case FaceDetectorMode::LARGE_FACES:
+                    mode = "LARGE_FACES";
+                    break;
+                case FaceDetectorMode::SMALL_FACES:
+                    mode = "SMALL_FACES";
+                    break;
+                default:
+                    break;
             }
-            else
-            {
-				//videoPath is of type std::wstring on windows, but std::string on other platforms.
-				cv::Mat img = cv::imread(std::string(videoPath.begin(), videoPath.end()));
 
-                // Create a frame
-                Frame frame(img.size().width, img.size().height, img.data, Frame::COLOR_FORMAT::BGR);
+            std::cout << "Face detector mode set to: " << mode << std::endl;
 
-                ((PhotoDetector *)detector.get())->process(frame); //Process an image
-            }
+            detector->start();    //Initialize the detectors .. call only once
+
+            const std::unique_ptr<PhotoResultCache> cache = makeResultCache(config, 0);
 
             do
             {
-                if (listenPtr->getDataSize() > 0)
-                {
-                    std::pair<Frame, std::map<FaceId, Face> > dataPoint = listenPtr->getData();
-                    Frame frame = dataPoint.first;
-                    std::map<FaceId, Face> faces = dataPoint.second;
-
-
-                    if (draw_display)
-                    {
-                        listenPtr->draw(faces, frame);
-                    }
-
-                    std::cerr << "timestamp: " << frame.getTimestamp()
-                    << " cfps: " << listenPtr->getCaptureFrameRate()
-                    << " pfps: " << listenPtr->getProcessingFrameRate()
-                    << " faces: "<< faces.size() << endl;
-
-                    listenPtr->outputToFile(faces, frame.getTimestamp());
-                }
-            } while (VIDEO_EXTS[fileExt] && (videoListenPtr->isRunning() || listenPtr->getDataSize() > 0));
-        } while(loop);
+                processInput(*detector, *listenPtr, inputPath, cache.get(), true);
+            } while(loop);
 
-        detector->stop();
+            detector->stop();
+        }
+        metrics.stop();
+        listenPtr->stopDisplay();
+        listenPtr->closeOutput();    // Final flush of the CSV writer thread
         csvFileStream.close();
 
+        if (listenPtr->getExportDroppedCount() > 0)
+        {
+            std::cerr << "Warning: " << listenPtr->getExportDroppedCount() << " frames were left out of " << export_path << " because the encoder fell behind" << std::endl;
+        }
+        if (listenPtr->getDroppedCount() > 0)
+        {
+            std::cerr << "Warning: " << listenPtr->getDroppedCount() << " results were dropped because the result queue was full" << std::endl;
+        }
+        std::cerr << "Result pool allocations: " << listenPtr->getPoolAllocationCount() << std::endl;
+        listenPtr->reportThroughput(std::cerr);
+        listenPtr->reportLatencies(std::cerr);
+
         std::cout << "Output written to file: " << csvPath << std::endl;
     }
     catch (AffdexException ex)
     {
         std::cerr << ex.what();
     }
+    catch (std::runtime_error &ex)
+    {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
 
     return 0;
 }